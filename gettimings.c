@@ -1,9 +1,22 @@
 // gettimings.c
-#define _XOPEN_SOURCE 700
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <getopt.h>
 #include <inttypes.h>
+#include <gnu/libc-version.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <spawn.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -12,11 +25,21 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/utsname.h>
 #include <sys/wait.h>
 #include <limits.h>
 
+#include <linux/futex.h>
+#include <linux/perf_event.h>
+
 // ---------- compiler barrier ----------
 #if defined(_MSC_VER)
   #include <intrin.h>
@@ -35,6 +58,111 @@ static inline uint64_t nsecs_now(void) {
     return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
 }
 
+// ---------- timed-region clock ----------
+// measure() reads ticks through clock_begin()/clock_end(). With the default
+// CLOCK_MONOTONIC backend a tick is 1 ns; the TSC backend counts cycles and
+// is converted with a ratio calibrated against CLOCK_MONOTONIC at startup.
+#if defined(__x86_64__) || defined(__i386__)
+  #include <cpuid.h>
+  #include <x86intrin.h>
+  #define HAVE_TSC 1
+#else
+  #define HAVE_TSC 0
+#endif
+
+enum clock_kind { CLOCK_KIND_MONOTONIC, CLOCK_KIND_TSC };
+
+static struct {
+    enum clock_kind kind;
+    bool   rdtscp;        // rdtscp available for the closing read
+    double ns_per_tick;
+} clk = { CLOCK_KIND_MONOTONIC, false, 1.0 };
+
+// Opening read: lfence keeps rdtsc from executing before earlier
+// instructions retire.
+static inline uint64_t clock_begin(void) {
+#if HAVE_TSC
+    if (clk.kind == CLOCK_KIND_TSC) {
+        _mm_lfence();
+        uint64_t t = __rdtsc();
+        _mm_lfence();
+        return t;
+    }
+#endif
+    return nsecs_now();
+}
+
+// Closing read: rdtscp waits for the timed code to finish, the trailing
+// lfence keeps later instructions from starting before the read.
+static inline uint64_t clock_end(void) {
+#if HAVE_TSC
+    if (clk.kind == CLOCK_KIND_TSC) {
+        uint64_t t;
+        if (clk.rdtscp) {
+            unsigned aux;
+            t = __rdtscp(&aux);
+        } else {
+            _mm_lfence();
+            t = __rdtsc();
+        }
+        _mm_lfence();
+        return t;
+    }
+#endif
+    return nsecs_now();
+}
+
+// Returns NULL if the TSC is usable, otherwise why not.
+static const char* tsc_unusable(void) {
+#if HAVE_TSC
+    unsigned a, b, c, d;
+    if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007)
+        return "cpuid leaf 0x80000007 not available";
+    __get_cpuid(0x80000001, &a, &b, &c, &d);
+    clk.rdtscp = (d >> 27) & 1;
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    if (!((d >> 8) & 1))
+        return "TSC is not invariant";
+    return NULL;
+#else
+    return "not an x86 CPU";
+#endif
+}
+
+// Median of three 20 ms busy-wait windows against CLOCK_MONOTONIC.
+static double tsc_calibrate(void) {
+    double r[3];
+    for (int k = 0; k < 3; ++k) {
+        uint64_t n0 = nsecs_now(), c0 = clock_begin(), n1, c1;
+        do { n1 = nsecs_now(); } while (n1 - n0 < 20 * 1000 * 1000);
+        c1 = clock_end();
+        r[k] = (double)(n1 - n0) / (double)(c1 - c0);
+    }
+    if (r[0] > r[1]) { double t = r[0]; r[0] = r[1]; r[1] = t; }
+    if (r[1] > r[2]) { double t = r[1]; r[1] = r[2]; r[2] = t; }
+    if (r[0] > r[1]) { double t = r[0]; r[0] = r[1]; r[1] = t; }
+    return r[1];
+}
+
+// --clock: tsc fails without an invariant TSC, auto falls back to
+// CLOCK_MONOTONIC with a note on stderr.
+enum clock_request { CLOCK_WANT_MONOTONIC, CLOCK_WANT_TSC, CLOCK_WANT_AUTO };
+
+static void clock_init(enum clock_request want) {
+    if (want == CLOCK_WANT_MONOTONIC) return;
+    const char* why = tsc_unusable();
+    if (why && want == CLOCK_WANT_TSC) {
+        fprintf(stderr, "TSC clock unavailable (%s); use --clock=auto to fall back\n", why);
+        exit(2);
+    }
+    if (why) {
+        fprintf(stderr, "note: TSC clock unavailable (%s), using CLOCK_MONOTONIC\n", why);
+        return;
+    }
+    clk.kind = CLOCK_KIND_TSC;
+    clk.ns_per_tick = tsc_calibrate();
+}
+
 // ---------- prevent optimization ----------
 __attribute__((noinline))
 static void empty_function(void) {
@@ -44,228 +172,4287 @@ static void empty_function(void) {
 static volatile uint64_t sink_u64;
 static volatile double   sink_double;
 
-// ========== measurement harness ==========
-typedef void (*action_fn)(void);
+// ========== result output ==========
+// Every result goes through out_begin()/out_*()/out_end(). The text format
+// is the original "label" line, "key,value" lines and a blank line. JSON
+// writes one object per result on one line and CSV writes
+// scenario,key,value rows; both carry the host metadata with each result
+// so files from many hosts can be concatenated.
+enum out_format { FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV };
 
-static void measure(const char* label,
-                    action_fn setup_each, action_fn action, action_fn teardown_each,
-                    uint64_t iters, bool subtract_overhead)
-{
-    if (iters == 0) { fprintf(stderr, "iters must be > 0\n"); exit(2); }
+static struct {
+    enum out_format fmt;
+    bool            csv_header;
+    bool            json_first;   // no comma before the next JSON member
+    const char*     key_prefix;   // CSV: "host." while writing host fields
+    char            scenario[256];
+} out = { .key_prefix = "" };
 
-    // warm-up
-    uint64_t warm = iters/10 + 1;
-    for (uint64_t i = 0; i < warm; ++i) {
-        if (setup_each) setup_each();
-        COMPILER_BARRIER();
-        action();
-        COMPILER_BARRIER();
-        if (teardown_each) teardown_each();
+static void json_string(const char* s) {
+    putchar('"');
+    for (; *s; ++s) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') printf("\\%c", ch);
+        else if (ch < 0x20) printf("\\u%04x", ch);
+        else putchar(ch);
     }
+    putchar('"');
+}
 
-    // timed
-    uint64_t total_ns = 0;
-    for (uint64_t i = 0; i < iters; ++i) {
-        if (setup_each) setup_each();
-        COMPILER_BARRIER();
-        uint64_t t0 = nsecs_now();
-        action();
-        uint64_t t1 = nsecs_now();
-        COMPILER_BARRIER();
-        if (teardown_each) teardown_each();
-        total_ns += (t1 - t0);
+static void csv_field(const char* s) {
+    if (!strpbrk(s, ",\"\n")) { fputs(s, stdout); return; }
+    putchar('"');
+    for (; *s; ++s) {
+        if (*s == '"') putchar('"');
+        putchar(*s);
     }
-    double mean_ns = (double)total_ns / (double)iters;
+    putchar('"');
+}
 
-    double overhead_ns = 0.0;
-    if (subtract_overhead) {
-        uint64_t total_o = 0;
-        for (uint64_t i = 0; i < iters; ++i) {
-            if (setup_each) setup_each();
-            COMPILER_BARRIER();
-            uint64_t t0 = nsecs_now();
-            // empty critical section
-            COMPILER_BARRIER();
-            uint64_t t1 = nsecs_now();
-            if (teardown_each) teardown_each();
-            total_o += (t1 - t0);
+static void out_field(const char* key, const char* value, bool numeric) {
+    switch (out.fmt) {
+        case FORMAT_TEXT:
+            printf("%s,%s\n", key, value);
+            break;
+        case FORMAT_JSON:
+            if (!out.json_first) putchar(',');
+            out.json_first = false;
+            json_string(key);
+            putchar(':');
+            if (!numeric) json_string(value);
+            else if (strpbrk(value, "in")) printf("null");   // inf, nan
+            else fputs(value, stdout);
+            break;
+        case FORMAT_CSV:
+            csv_field(out.scenario);
+            putchar(',');
+            fputs(out.key_prefix, stdout);
+            csv_field(key);
+            putchar(',');
+            csv_field(value);
+            putchar('\n');
+            break;
+    }
+}
+
+__attribute__((format(printf, 2, 3)))
+static void out_num(const char* key, const char* fmt, ...) {
+    char buf[64];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof buf, fmt, ap);
+    va_end(ap);
+    out_field(key, buf, true);
+}
+
+__attribute__((format(printf, 2, 3)))
+static void out_str(const char* key, const char* fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof buf, fmt, ap);
+    va_end(ap);
+    out_field(key, buf, false);
+}
+
+// CSV header, written once by the driver before scenarios run in children.
+static void out_header(void) {
+    if (out.fmt == FORMAT_CSV && !out.csv_header) printf("scenario,key,value\n");
+    out.csv_header = true;
+}
+
+static void out_begin(const char* scenario) {
+    snprintf(out.scenario, sizeof out.scenario, "%s", scenario);
+    switch (out.fmt) {
+        case FORMAT_TEXT:
+            printf("%s\n", scenario);
+            break;
+        case FORMAT_JSON:
+            printf("{\"scenario\":");
+            json_string(scenario);
+            out.json_first = false;
+            break;
+        case FORMAT_CSV:
+            out_header();
+            break;
+    }
+}
+
+// ---------- host metadata ----------
+static struct {
+    bool collected;
+    char hostname[256];
+    char kernel[512];
+    char cpu_model[256];
+    long ncpu_online;
+    char governor[256];
+    char thp[256];
+    char turbo[16];
+    char smt[16];
+    char loadavg[256];
+    double load1;
+    char cpu_max[256];      // cgroup v2 cpu.max of the tightest ancestor
+} host;
+
+// First line of a file without the newline, or "unknown".
+static void read_line(const char* path, char* buf, size_t len) {
+    FILE* f = fopen(path, "r");
+    if (!f || !fgets(buf, (int)len, f)) snprintf(buf, len, "unknown");
+    else buf[strcspn(buf, "\n")] = '\0';
+    if (f) fclose(f);
+}
+
+// The active choice in a sysfs list such as "always [madvise] never".
+static void read_bracketed(const char* path, char* buf, size_t len) {
+    char line[256];
+    read_line(path, line, sizeof line);
+    char* lb = strchr(line, '[');
+    char* rb = lb ? strchr(lb, ']') : NULL;
+    if (lb && rb) { *rb = '\0'; snprintf(buf, len, "%s", lb + 1); }
+    else snprintf(buf, len, "%s", line);
+}
+
+// "on"/"off" from a sysfs flag; invert for files like no_turbo.
+static bool read_flag(const char* path, bool invert, char* buf, size_t len) {
+    char line[64];
+    read_line(path, line, sizeof line);
+    if (strcmp(line, "0") != 0 && strcmp(line, "1") != 0) return false;
+    snprintf(buf, len, "%s", (line[0] == '1') != invert ? "on" : "off");
+    return true;
+}
+
+// Walk from our cgroup up to the root and report the first cpu.max that
+// is not "max"; any ancestor's quota throttles us.
+static void read_cpu_max(char* buf, size_t len) {
+    snprintf(buf, len, "unknown");
+    char line[PATH_MAX];
+    FILE* f = fopen("/proc/self/cgroup", "r");
+    bool v2 = false;
+    while (f && !v2 && fgets(line, sizeof line, f)) v2 = strncmp(line, "0::", 3) == 0;
+    if (f) fclose(f);
+    if (!v2) return;   // cgroup v1 only
+    line[strcspn(line, "\n")] = '\0';
+    char path[PATH_MAX + 32];
+    char* cg = line + 3;
+    for (;;) {
+        char v[256];
+        snprintf(path, sizeof path, "/sys/fs/cgroup%s/cpu.max", strcmp(cg, "/") ? cg : "");
+        read_line(path, v, sizeof v);
+        if (strcmp(v, "unknown") != 0) {
+            if (strncmp(v, "max", 3) != 0) { snprintf(buf, len, "%s", v); return; }
+            snprintf(buf, len, "max");
         }
-        overhead_ns = (double)total_o / (double)iters;
+        char* slash = strrchr(cg, '/');
+        if (!slash || slash == cg) break;
+        *slash = '\0';
     }
+    if (strcmp(buf, "unknown") == 0) snprintf(buf, len, "max");   // root has no cpu.max
+}
 
-    printf("%s\n", label);
-    printf("iters,%" PRIu64 "\n", iters);
-    printf("mean_ns_total,%.3f\n", mean_ns);
-    if (subtract_overhead) {
-        printf("mean_ns_overhead,%.3f\n", overhead_ns);
-        printf("mean_ns_subtracted,%.3f\n", mean_ns - overhead_ns);
+static void host_collect(void) {
+    if (host.collected) return;
+    host.collected = true;
+
+    struct utsname u;
+    if (uname(&u) == 0) {
+        snprintf(host.hostname, sizeof host.hostname, "%s", u.nodename);
+        snprintf(host.kernel, sizeof host.kernel, "%s %s %s %s",
+                 u.sysname, u.release, u.version, u.machine);
+    }
+
+    snprintf(host.cpu_model, sizeof host.cpu_model, "unknown");
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    char line[512];
+    while (f && fgets(line, sizeof line, f)) {
+        if (strncmp(line, "model name", 10) != 0) continue;
+        char* v = strchr(line, ':');
+        if (!v) continue;
+        v += strspn(v + 1, " \t") + 1;
+        v[strcspn(v, "\n")] = '\0';
+        snprintf(host.cpu_model, sizeof host.cpu_model, "%s", v);
+        break;
     }
-    printf("\n");
+    if (f) fclose(f);
+
+    host.ncpu_online = sysconf(_SC_NPROCESSORS_ONLN);
+    read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor",
+              host.governor, sizeof host.governor);
+    read_bracketed("/sys/kernel/mm/transparent_hugepage/enabled", host.thp, sizeof host.thp);
+    if (!read_flag("/sys/devices/system/cpu/intel_pstate/no_turbo", true, host.turbo, sizeof host.turbo) &&
+        !read_flag("/sys/devices/system/cpu/cpufreq/boost", false, host.turbo, sizeof host.turbo))
+        snprintf(host.turbo, sizeof host.turbo, "unknown");
+    if (!read_flag("/sys/devices/system/cpu/smt/active", false, host.smt, sizeof host.smt))
+        snprintf(host.smt, sizeof host.smt, "unknown");
+    read_line("/proc/loadavg", host.loadavg, sizeof host.loadavg);
+    host.load1 = strtod(host.loadavg, NULL);
+    // keep the three averages only
+    char* sp = host.loadavg;
+    for (int k = 0; k < 3 && sp; ++k) sp = strchr(sp + 1, ' ');
+    if (sp) *sp = '\0';
+    read_cpu_max(host.cpu_max, sizeof host.cpu_max);
 }
 
-// ========== scenarios ==========
+#ifndef GT_BUILD_FLAGS
+  #define GT_BUILD_FLAGS "unknown"
+#endif
 
-// 1) empty function
-static void act_call_empty(void) { empty_function(); }
+static void out_host_fields(void) {
+    host_collect();
+    out_str("hostname", "%s", host.hostname);
+    out_str("kernel", "%s", host.kernel);
+    out_str("cpu_model", "%s", host.cpu_model);
+    out_num("cpus_online", "%ld", host.ncpu_online);
+    out_str("governor", "%s", host.governor);
+    out_str("thp", "%s", host.thp);
+    out_str("turbo", "%s", host.turbo);
+    out_str("smt", "%s", host.smt);
+    out_str("loadavg", "%s", host.loadavg);
+    out_str("cgroup_cpu_max", "%s", host.cpu_max);
+    out_str("glibc", "%s", gnu_get_libc_version());
+    out_str("compiler", "%s", __VERSION__);
+    out_str("cflags", "%s", GT_BUILD_FLAGS);
+}
 
-// 2) drand48
-static void act_drand48(void) { sink_double = drand48(); }
+static void out_end(void) {
+    switch (out.fmt) {
+        case FORMAT_TEXT:
+            printf("\n");
+            break;
+        case FORMAT_JSON:
+            printf(",\"host\":{");
+            out.json_first = true;
+            out_host_fields();
+            printf("}}\n");
+            break;
+        case FORMAT_CSV:
+            out.key_prefix = "host.";
+            out_host_fields();
+            out.key_prefix = "";
+            break;
+    }
+    fflush(stdout);
+}
 
-// 3) getppid
-static void act_getppid(void) { sink_u64 = (uint64_t)getppid(); }
+// ========== statistics ==========
+enum { OUT_LOW_SEVERE, OUT_LOW_MILD, OUT_HIGH_MILD, OUT_HIGH_SEVERE, OUT_CLASSES };
+static const char* const outlier_class_names[OUT_CLASSES] = {
+    "low_severe", "low_mild", "high_mild", "high_severe"
+};
 
-// 4) fork() return in parent
-static pid_t last_child = -1;
-static void act_fork_parent_return(void) {
-    pid_t p = fork();
-    if (p < 0) { perror("fork"); exit(1); }
-    if (p == 0) { _exit(0); }
-    last_child = p;
-    sink_u64 ^= (uint64_t)p;
+#define TRIM_FRACTION 0.10
+
+struct stats {
+    uint64_t n;
+    double min, p50, p90, p99, p999, max;
+    double mean, stddev;
+
+    // robust estimators
+    double   mad;                  // median absolute deviation from p50
+    double   trimmed_mean;         // TRIM_FRACTION cut from each end
+    double   fence[OUT_CLASSES];   // Tukey fences: 3, 1.5 IQR below q1; 1.5, 3 above q3
+    uint64_t outliers[OUT_CLASSES];
+
+    // 95% confidence intervals, if ci_method is set
+    const char* ci_method;
+    double median_lo, median_hi, mean_lo, mean_hi;
+};
+
+// The IQR is at least min_iqr, the resolution of the samples: with a
+// quantized clock it is often 0 on cheap actions, which would put every
+// fence on the median and call each sample a tick away a severe outlier.
+static void set_fences(struct stats* st, double q1, double q3, double min_iqr) {
+    double iqr = q3 - q1 > min_iqr ? q3 - q1 : min_iqr;
+    st->fence[OUT_LOW_SEVERE]  = q1 - 3.0 * iqr;
+    st->fence[OUT_LOW_MILD]    = q1 - 1.5 * iqr;
+    st->fence[OUT_HIGH_MILD]   = q3 + 1.5 * iqr;
+    st->fence[OUT_HIGH_SEVERE] = q3 + 3.0 * iqr;
 }
-static void teardown_wait_for_last_child(void) {
-    if (last_child > 0) {
-        int st;
-        if (waitpid(last_child, &st, 0) < 0) { perror("waitpid"); exit(1); }
-        last_child = -1;
+
+// -1 if x is inside the mild fences
+static int outlier_class(const struct stats* st, double x) {
+    if (x < st->fence[OUT_LOW_SEVERE])  return OUT_LOW_SEVERE;
+    if (x < st->fence[OUT_LOW_MILD])    return OUT_LOW_MILD;
+    if (x > st->fence[OUT_HIGH_SEVERE]) return OUT_HIGH_SEVERE;
+    if (x > st->fence[OUT_HIGH_MILD])   return OUT_HIGH_MILD;
+    return -1;
+}
+
+static int cmp_i64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of an already sorted array
+static double percentile_sorted(const int64_t* v, uint64_t n, double p) {
+    uint64_t rank = (uint64_t)ceil(p / 100.0 * (double)n);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return (double)v[rank - 1];
+}
+
+// The deviations to the left and to the right of the median are each
+// sorted, so merging them from the median outwards finds their median.
+static double mad_sorted(const int64_t* v, uint64_t n, double med) {
+    uint64_t r = 0;
+    while (r < n && (double)v[r] <= med) ++r;
+    int64_t l = (int64_t)r - 1;
+    double d = 0.0;
+    for (uint64_t k = 0; k < (n + 1) / 2; ++k) {
+        double dl = l >= 0 ? med - (double)v[l] : INFINITY;
+        double dr = r < n ? (double)v[r] - med : INFINITY;
+        if (dl <= dr) { d = dl; --l; }
+        else { d = dr; ++r; }
     }
+    return d;
 }
 
-// 5) waitpid already-terminated
-static pid_t ready_zombie = -1;
-static void setup_waitpid_ready(void) {
-    pid_t p = fork();
-    if (p < 0) { perror("fork"); exit(1); }
-    if (p == 0) { _exit(0); }
-    struct timespec ts = { .tv_sec = 0, .tv_nsec = 2*1000*1000 }; // 2 ms
-    nanosleep(&ts, NULL);
-    ready_zombie = p;
+// sorts v in place
+static void compute_stats(int64_t* v, uint64_t n, struct stats* st) {
+    qsort(v, n, sizeof v[0], cmp_i64);
+
+    double sum = 0.0;
+    for (uint64_t i = 0; i < n; ++i) sum += (double)v[i];
+    double mean = sum / (double)n;
+    double sq = 0.0;
+    for (uint64_t i = 0; i < n; ++i) {
+        double d = (double)v[i] - mean;
+        sq += d * d;
+    }
+
+    st->n      = n;
+    st->min    = (double)v[0];
+    st->p50    = percentile_sorted(v, n, 50.0);
+    st->p90    = percentile_sorted(v, n, 90.0);
+    st->p99    = percentile_sorted(v, n, 99.0);
+    st->p999   = percentile_sorted(v, n, 99.9);
+    st->max    = (double)v[n - 1];
+    st->mean   = mean;
+    st->stddev = n > 1 ? sqrt(sq / (double)(n - 1)) : 0.0;
+
+    st->mad = mad_sorted(v, n, st->p50);
+    uint64_t cut = (uint64_t)((double)n * TRIM_FRACTION);
+    double tsum = 0.0;
+    for (uint64_t i = cut; i < n - cut; ++i) tsum += (double)v[i];
+    st->trimmed_mean = tsum / (double)(n - 2 * cut);
+
+    set_fences(st, percentile_sorted(v, n, 25.0), percentile_sorted(v, n, 75.0), 1.0);
+    memset(st->outliers, 0, sizeof st->outliers);
+    for (uint64_t i = 0; i < n; ++i) {
+        int c = outlier_class(st, (double)v[i]);
+        if (c >= 0) st->outliers[c]++;
+    }
+    st->ci_method = NULL;
 }
-static void act_waitpid_ready(void) {
-    int st;
-    pid_t r = waitpid(ready_zombie, &st, 0);
-    if (r != ready_zombie) { perror("waitpid"); exit(1); }
-    sink_u64 ^= (uint64_t)r;
+
+// splitmix64; the bootstrap must not disturb drand48(), which scenario 2
+// measures
+static inline uint64_t rng_next(uint64_t* s) {
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
 }
-// NEW: teardown that reaps child if needed
-static void teardown_wait_ready(void) {
-    if (ready_zombie > 0) {
-        int st;
-        pid_t r = waitpid(ready_zombie, &st, 0);
-        if (r < 0 && errno != ECHILD) { perror("waitpid"); exit(1); }
-        ready_zombie = -1;
+
+// 32-bit targets (i386) have no 128-bit multiply; they reject the draws
+// below 2^64 mod n, which would bias the modulo
+static inline uint64_t rng_below(uint64_t* s, uint64_t n) {
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)(((unsigned __int128)rng_next(s) * n) >> 64);
+#else
+    uint64_t reject = -n % n;
+    for (;;) {
+        uint64_t r = rng_next(s);
+        if (r >= reject) return r % n;
     }
+#endif
 }
 
-// 6) child exits + waitpid
-static void act_fork_child_exit_wait(void) {
-    pid_t p = fork();
-    if (p < 0) { perror("fork"); exit(1); }
-    if (p == 0) { _exit(0); }
-    int st;
-    if (waitpid(p, &st, 0) < 0) { perror("waitpid"); exit(1); }
-    sink_u64 ^= (uint64_t)st;
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
 }
 
-// 7) system("/bin/true")
-static const char* TRUE_PATH = "/bin/true";
-static void act_system_true(void) {
-    int rc = system(TRUE_PATH);
-    if (rc == -1) { perror("system"); exit(1); }
+// Percentile bootstrap over `rounds` resamples of the sorted samples v.
+// Each resample is kept as draw counts per index, which gives its median
+// by a prefix scan instead of a sort.
+static void bootstrap_ci(const int64_t* v, uint64_t n, unsigned rounds, struct stats* st) {
+    if (rounds < 2 || n < 2) return;
+    uint32_t* cnt = malloc(n * sizeof *cnt);
+    double* meds = malloc(rounds * sizeof *meds);
+    double* means = malloc(rounds * sizeof *means);
+    if (!cnt || !meds || !means) { perror("malloc bootstrap"); exit(1); }
+
+    uint64_t rng = 0xC0FFEE;
+    for (unsigned b = 0; b < rounds; ++b) {
+        memset(cnt, 0, n * sizeof *cnt);
+        double sum = 0.0;
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t j = rng_below(&rng, n);
+            cnt[j]++;
+            sum += (double)v[j];
+        }
+        uint64_t seen = 0, j = 0;
+        while ((seen += cnt[j]) < (n + 1) / 2) ++j;
+        meds[b] = (double)v[j];
+        means[b] = sum / (double)n;
+    }
+    qsort(meds, rounds, sizeof *meds, cmp_double);
+    qsort(means, rounds, sizeof *means, cmp_double);
+    unsigned lo = (unsigned)(0.025 * rounds), hi = (unsigned)ceil(0.975 * rounds) - 1;
+    st->ci_method = "bootstrap";
+    st->median_lo = meds[lo];
+    st->median_hi = meds[hi];
+    st->mean_lo = means[lo];
+    st->mean_hi = means[hi];
+
+    free(cnt);
+    free(meds);
+    free(means);
 }
 
-// 8) mkdir + rmdir
-static char dir_template[] = "/tmp/gtXXXXXX";
-static char workdir[PATH_MAX];
-static void setup_mkdir_rmdir(void) {
-    strcpy(workdir, dir_template);
+// Stats are kept in clock ticks; reports are in report.unit.
+static struct {
+    const char* unit;
+    double      per_tick;
+} report = { "ns", 1.0 };
+
+// one "<stat>_<unit>_<suffix>" field, value converted from ticks
+static void out_stat(const char* stat, const char* suffix, double ticks) {
+    char key[256];
+    snprintf(key, sizeof key, "%s_%s_%s", stat, report.unit, suffix);
+    out_num(key, "%.3f", ticks * report.per_tick);
 }
-static void act_mkdir_rmdir(void) {
-    char buf[PATH_MAX];
-    strcpy(buf, workdir);
-    if (!mkdtemp(buf)) { perror("mkdtemp"); exit(1); }
-    if (rmdir(buf) != 0) { perror("rmdir"); exit(1); }
+
+static void print_stats(const char* suffix, const struct stats* st) {
+    out_stat("mean",   suffix, st->mean);
+    out_stat("stddev", suffix, st->stddev);
+    out_stat("min",    suffix, st->min);
+    out_stat("p50",    suffix, st->p50);
+    out_stat("p90",    suffix, st->p90);
+    out_stat("p99",    suffix, st->p99);
+    out_stat("p999",   suffix, st->p999);
+    out_stat("max",    suffix, st->max);
+    out_stat("mad",          suffix, st->mad);
+    out_stat("trimmed_mean", suffix, st->trimmed_mean);
+    for (int c = 0; c < OUT_CLASSES; ++c) {
+        char key[128];
+        snprintf(key, sizeof key, "outliers_%s_%s", outlier_class_names[c], suffix);
+        out_num(key, "%" PRIu64, st->outliers[c]);
+        snprintf(key, sizeof key, "fence_%s", outlier_class_names[c]);
+        out_stat(key, suffix, st->fence[c]);
+    }
+    if (st->ci_method) {
+        out_stat("median_ci95_lo", suffix, st->median_lo);
+        out_stat("median_ci95_hi", suffix, st->median_hi);
+        out_stat("mean_ci95_lo",   suffix, st->mean_lo);
+        out_stat("mean_ci95_hi",   suffix, st->mean_hi);
+    }
 }
 
-// ========== driver ==========
-static void usage(const char* prog) {
-    fprintf(stderr,
-        "Usage: %s <scenario 1..8>\n", prog);
+// How the robust fields were derived, once per result.
+static void print_stats_method(const struct stats* st, unsigned rounds) {
+    out_str("outlier_rule", "Tukey fences: mild beyond 1.5 IQR; severe beyond 3 IQR; "
+            "IQR at least 1 tick (1 histogram bin)");
+    out_num("trim_fraction", "%.2f", TRIM_FRACTION);
+    if (st->ci_method && strcmp(st->ci_method, "bootstrap") == 0)
+        out_str("ci_method", "percentile bootstrap (%u resamples)", rounds);
+    else if (st->ci_method)
+        out_str("ci_method", "%s", st->ci_method);
 }
 
-int main(int argc, char** argv) {
-    if (argc != 2) { usage(argv[0]); return 2; }
-    int which = atoi(argv[1]);
+// per-quantile subtraction; the spread of a difference of two
+// distributions is not a difference of spreads, so no stddev here
+static void print_stats_subtracted(const struct stats* t, const struct stats* o) {
+    out_stat("mean", "subtracted", t->mean - o->mean);
+    out_stat("min",  "subtracted", t->min  - o->min);
+    out_stat("p50",  "subtracted", t->p50  - o->p50);
+    out_stat("p90",  "subtracted", t->p90  - o->p90);
+    out_stat("p99",  "subtracted", t->p99  - o->p99);
+    out_stat("p999", "subtracted", t->p999 - o->p999);
+    out_stat("max",  "subtracted", t->max  - o->max);
+    out_stat("trimmed_mean", "subtracted", t->trimmed_mean - o->trimmed_mean);
+}
 
-    uint64_t iters;
-    bool subtract_overhead;
+// Converts stats over batches of k actions into per-action stats.
+static void stats_per_op(struct stats* st, uint64_t k) {
+    double f = 1.0 / (double)k;
+    st->min *= f; st->p50 *= f; st->p90 *= f; st->p99 *= f;
+    st->p999 *= f; st->max *= f; st->mean *= f; st->stddev *= f;
+    st->mad *= f; st->trimmed_mean *= f;
+    for (int c = 0; c < OUT_CLASSES; ++c) st->fence[c] *= f;
+    st->median_lo *= f; st->median_hi *= f; st->mean_lo *= f; st->mean_hi *= f;
+}
 
-    if (access(TRUE_PATH, X_OK) != 0 && access("/usr/bin/true", X_OK) == 0) {
-        TRUE_PATH = "/usr/bin/true";
+// Picks the report unit for data whose ticks are ns_per_tick long.
+// Cycles are only meaningful when the ticks are TSC cycles.
+static void report_init(bool cycles, double ns_per_tick, bool ticks_are_cycles) {
+    if (cycles && !ticks_are_cycles)
+        fprintf(stderr, "note: cycles need the TSC clock, reporting ns\n");
+    if (cycles && ticks_are_cycles) {
+        report.unit = "cycles";
+        report.per_tick = 1.0;
+    } else {
+        report.unit = "ns";
+        report.per_tick = ns_per_tick;
     }
+}
 
-    srand48(0xC0FFEE);
+// ========== log-linear histogram ==========
+// HdrHistogram layout: each power of two is split into HIST_SUB_HALF linear
+// sub-buckets, so any recorded value is kept to within 1/1024 (3 significant
+// digits) from 1 tick up to 2^HIST_MAX_BITS ticks (~73 min in ns, ~24 min
+// in cycles at 3 GHz). Fixed size, no allocation on record, and two
+// histograms merge by adding counts.
+#define HIST_SUB_BITS   11
+#define HIST_SUB_COUNT  (1u << HIST_SUB_BITS)
+#define HIST_SUB_HALF   (HIST_SUB_COUNT / 2)
+#define HIST_MAX_BITS   42
+#define HIST_BUCKETS    (HIST_MAX_BITS - HIST_SUB_BITS + 1)
+#define HIST_LEN        ((HIST_BUCKETS + 1) * HIST_SUB_HALF)
+#define HIST_MAX_VALUE  ((int64_t)((1ull << HIST_MAX_BITS) - 1))
 
-    switch (which) {
-        case 1:
-            iters = 200000;
-            subtract_overhead = true;
-            measure("scenario_1_empty_function_call",
-                    NULL, act_call_empty, NULL,
-                    iters, subtract_overhead);
-            break;
-        case 2:
-            iters = 200000;
-            subtract_overhead = true;
-            measure("scenario_2_drand48",
-                    NULL, act_drand48, NULL,
-                    iters, subtract_overhead);
-            break;
-        case 3:
-            iters = 200000;
-            subtract_overhead = true;
-            measure("scenario_3_getppid",
-                    NULL, act_getppid, NULL,
-                    iters, subtract_overhead);
-            break;
-        case 4:
-            iters = 8000;
-            subtract_overhead = true;
-            measure("scenario_4_fork_parent_return",
-                    NULL, act_fork_parent_return, teardown_wait_for_last_child,
-                    iters, subtract_overhead);
-            break;
-        case 5:
-            iters = 2000; // smaller default to avoid resource limits
-            subtract_overhead = true;
-            measure("scenario_5_waitpid_already_terminated",
-                    setup_waitpid_ready, act_waitpid_ready, teardown_wait_ready,
-                    iters, subtract_overhead);
-            break;
-        case 6:
-            iters = 4000;
-            subtract_overhead = false;
-            measure("scenario_6_fork_child_exit_waitpid",
-                    NULL, act_fork_child_exit_wait, NULL,
-                    iters, subtract_overhead);
-            break;
-        case 7:
-            iters = 2500;
-            subtract_overhead = false;
-            measure("scenario_7_system_true",
-                    NULL, act_system_true, NULL,
-                    iters, subtract_overhead);
-            break;
-        case 8:
-            iters = 20000;
-            subtract_overhead = true;
-            measure("scenario_8_mkdir_rmdir",
-                    setup_mkdir_rmdir, act_mkdir_rmdir, NULL,
-                    iters, subtract_overhead);
-            break;
-        default:
-            usage(argv[0]); return 2;
+struct hist {
+    uint64_t total;
+    uint64_t overflow;   // values clamped to HIST_MAX_VALUE
+    int64_t  min, max;
+    uint64_t sum;
+    uint64_t counts[HIST_LEN];
+};
+
+static void hist_init(struct hist* h) {
+    memset(h, 0, sizeof *h);   // touch every page up front
+    h->min = INT64_MAX;
+}
+
+static struct hist* hist_new(void) {
+    struct hist* h = malloc(sizeof *h);
+    if (!h) { perror("malloc hist"); exit(1); }
+    hist_init(h);
+    return h;
+}
+
+static inline uint32_t hist_index(int64_t v) {
+    uint64_t u = (uint64_t)v;
+    int bucket = 64 - HIST_SUB_BITS - __builtin_clzll(u | (HIST_SUB_COUNT - 1));
+    uint64_t sub = u >> bucket;
+    return (uint32_t)(((uint64_t)(bucket + 1) << (HIST_SUB_BITS - 1)) + sub - HIST_SUB_HALF);
+}
+
+static inline void hist_record(struct hist* h, int64_t v) {
+    if (v < 0) v = 0;
+    if (v > HIST_MAX_VALUE) { v = HIST_MAX_VALUE; h->overflow++; }
+    h->counts[hist_index(v)]++;
+    h->total++;
+    h->sum += (uint64_t)v;
+    if (v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+}
+
+// [lo, lo + width) is the range of values sharing counts[idx]
+static void hist_bin(uint32_t idx, int64_t* lo, int64_t* width) {
+    int bucket = (int)(idx >> (HIST_SUB_BITS - 1)) - 1;
+    uint64_t sub = (idx & (HIST_SUB_HALF - 1)) + HIST_SUB_HALF;
+    if (bucket < 0) { sub -= HIST_SUB_HALF; bucket = 0; }
+    *lo = (int64_t)(sub << bucket);
+    *width = (int64_t)1 << bucket;
+}
+
+static void hist_merge(struct hist* dst, const struct hist* src) {
+    for (uint32_t i = 0; i < HIST_LEN; ++i) dst->counts[i] += src->counts[i];
+    dst->total    += src->total;
+    dst->overflow += src->overflow;
+    dst->sum      += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// value of the rank-th smallest sample (1-based), reported as the highest
+// value equivalent to its bin
+static double hist_at_rank(const struct hist* h, uint64_t rank) {
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HIST_LEN; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            int64_t lo, width;
+            hist_bin(i, &lo, &width);
+            int64_t v = lo + width - 1;
+            return (double)(v > h->max ? h->max : v);
+        }
     }
+    return (double)h->max;
+}
 
-    return 0;
+// nearest-rank percentile
+static double hist_percentile(const struct hist* h, double p) {
+    uint64_t rank = (uint64_t)ceil(p / 100.0 * (double)h->total);
+    return hist_at_rank(h, rank < 1 ? 1 : rank);
+}
+
+static double hist_mid(uint32_t idx) {
+    int64_t lo, width;
+    hist_bin(idx, &lo, &width);
+    return (double)lo + (double)(width - 1) / 2.0;
+}
+
+// as mad_sorted(), over bins
+static double hist_mad(const struct hist* h, double med) {
+    uint64_t need = (h->total + 1) / 2, seen = 0;
+    int64_t r = 0;
+    while (r < HIST_LEN && hist_mid((uint32_t)r) <= med) ++r;
+    int64_t l = r - 1;
+    for (;;) {
+        while (l >= 0 && !h->counts[l]) --l;
+        while (r < HIST_LEN && !h->counts[r]) ++r;
+        double dl = l >= 0 ? med - hist_mid((uint32_t)l) : INFINITY;
+        double dr = r < HIST_LEN ? hist_mid((uint32_t)r) - med : INFINITY;
+        if (isinf(dl) && isinf(dr)) return 0.0;
+        if (dl <= dr) {
+            if ((seen += h->counts[l--]) >= need) return dl;
+        } else {
+            if ((seen += h->counts[r++]) >= need) return dr;
+        }
+    }
+}
+
+// Robust fields from bin midpoints. There are no samples to resample, so
+// the median CI uses order statistics and the mean CI the normal
+// approximation.
+static void hist_robust(const struct hist* h, struct stats* st) {
+    uint64_t n = h->total;
+    st->mad = hist_mad(h, st->p50);
+    int64_t lo, width;
+    hist_bin(hist_index((int64_t)st->p50), &lo, &width);
+    set_fences(st, hist_percentile(h, 25.0), hist_percentile(h, 75.0), (double)width);
+    memset(st->outliers, 0, sizeof st->outliers);
+
+    uint64_t cut = (uint64_t)((double)n * TRIM_FRACTION), seen = 0;
+    double tsum = 0.0;
+    for (uint32_t i = 0; i < HIST_LEN; ++i) {
+        uint64_t c = h->counts[i];
+        if (!c) continue;
+        double mid = hist_mid(i);
+        int cls = outlier_class(st, mid);
+        if (cls >= 0) st->outliers[cls] += c;
+        uint64_t from = seen > cut ? seen : cut;
+        uint64_t to = seen + c < n - cut ? seen + c : n - cut;
+        if (to > from) tsum += (double)(to - from) * mid;
+        seen += c;
+    }
+    st->trimmed_mean = tsum / (double)(n - 2 * cut);
+
+    double half = 1.96 * sqrt((double)n) / 2.0;
+    double lo_r = floor((double)n / 2.0 - half), hi_r = ceil((double)n / 2.0 + half) + 1.0;
+    st->ci_method = NULL;
+    if (lo_r >= 1.0 && hi_r <= (double)n) {
+        st->ci_method = "order statistics (median); normal approximation (mean)";
+        st->median_lo = hist_at_rank(h, (uint64_t)lo_r);
+        st->median_hi = hist_at_rank(h, (uint64_t)hi_r);
+        double se = st->stddev / sqrt((double)n);
+        st->mean_lo = st->mean - 1.96 * se;
+        st->mean_hi = st->mean + 1.96 * se;
+    }
+}
+
+static void hist_stats(const struct hist* h, struct stats* st) {
+    double mean = (double)h->sum / (double)h->total;
+    double sq = 0.0;
+    for (uint32_t i = 0; i < HIST_LEN; ++i) {
+        if (!h->counts[i]) continue;
+        int64_t lo, width;
+        hist_bin(i, &lo, &width);
+        double d = (double)lo + (double)(width - 1) / 2.0 - mean;
+        sq += d * d * (double)h->counts[i];
+    }
+
+    st->n      = h->total;
+    st->min    = (double)h->min;
+    st->p50    = hist_percentile(h, 50.0);
+    st->p90    = hist_percentile(h, 90.0);
+    st->p99    = hist_percentile(h, 99.0);
+    st->p999   = hist_percentile(h, 99.9);
+    st->max    = (double)h->max;
+    st->mean   = mean;
+    st->stddev = h->total > 1 ? sqrt(sq / (double)(h->total - 1)) : 0.0;
+    hist_robust(h, st);
+}
+
+// What the recorded values mean: one value per sample of `batch` actions,
+// in ticks of ns_per_tick.
+struct hist_meta {
+    char     label[256];
+    char     series[256];
+    bool     tsc;
+    double   ns_per_tick;
+    uint64_t batch;
+};
+
+// Text format, one file per series: a header followed by "index count"
+// lines for the non-empty bins.
+static void hist_save(const struct hist* h, const char* dir, const struct hist_meta* m) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof path, "%s/%s_%s.hist", dir, m->label, m->series);
+    FILE* f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+    fprintf(f, "gettimings-hist 1\n");
+    fprintf(f, "label %s\n", m->label);
+    fprintf(f, "series %s\n", m->series);
+    fprintf(f, "layout %d %d\n", HIST_SUB_BITS, HIST_MAX_BITS);
+    fprintf(f, "clock %s %.9g\n", m->tsc ? "tsc" : "monotonic", m->ns_per_tick);
+    fprintf(f, "batch %" PRIu64 "\n", m->batch);
+    fprintf(f, "total %" PRIu64 "\n", h->total);
+    fprintf(f, "overflow %" PRIu64 "\n", h->overflow);
+    fprintf(f, "min %" PRId64 "\n", h->min);
+    fprintf(f, "max %" PRId64 "\n", h->max);
+    fprintf(f, "sum %" PRIu64 "\n", h->sum);
+    for (uint32_t i = 0; i < HIST_LEN; ++i)
+        if (h->counts[i]) fprintf(f, "%" PRIu32 " %" PRIu64 "\n", i, h->counts[i]);
+    if (fclose(f) != 0) { perror(path); exit(1); }
+}
+
+static void hist_load(const char* path, struct hist* h, struct hist_meta* m) {
+    FILE* f = fopen(path, "r");
+    if (!f) { perror(path); exit(1); }
+    int version, sub_bits, max_bits;
+    char clock_name[16];
+    memset(h, 0, sizeof *h);
+    if (fscanf(f, "gettimings-hist %d", &version) != 1 || version != 1 ||
+        fscanf(f, " label %255s", m->label) != 1 ||
+        fscanf(f, " series %255s", m->series) != 1 ||
+        fscanf(f, " layout %d %d", &sub_bits, &max_bits) != 2 ||
+        fscanf(f, " clock %15s %lf", clock_name, &m->ns_per_tick) != 2 ||
+        fscanf(f, " batch %" SCNu64, &m->batch) != 1 ||
+        fscanf(f, " total %" SCNu64, &h->total) != 1 ||
+        fscanf(f, " overflow %" SCNu64, &h->overflow) != 1 ||
+        fscanf(f, " min %" SCNd64, &h->min) != 1 ||
+        fscanf(f, " max %" SCNd64, &h->max) != 1 ||
+        fscanf(f, " sum %" SCNu64, &h->sum) != 1) {
+        fprintf(stderr, "%s: not a gettimings histogram\n", path); exit(2);
+    }
+    if (sub_bits != HIST_SUB_BITS || max_bits != HIST_MAX_BITS) {
+        fprintf(stderr, "%s: incompatible histogram layout\n", path); exit(2);
+    }
+    m->tsc = strcmp(clock_name, "tsc") == 0;
+    uint32_t idx;
+    uint64_t c;
+    while (fscanf(f, " %" SCNu32 " %" SCNu64, &idx, &c) == 2) {
+        if (idx >= HIST_LEN) { fprintf(stderr, "%s: bad bin %" PRIu32 "\n", path, idx); exit(2); }
+        h->counts[idx] += c;
+    }
+    fclose(f);
+}
+
+// Raw samples are saved in the same spirit: a header like the histogram's,
+// then one tick count per line.
+static void samples_save(const int64_t* v, uint64_t n, const char* dir, const struct hist_meta* m) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof path, "%s/%s_%s.samples", dir, m->label, m->series);
+    FILE* f = fopen(path, "w");
+    if (!f) { perror(path); exit(1); }
+    fprintf(f, "gettimings-samples 1\n");
+    fprintf(f, "label %s\n", m->label);
+    fprintf(f, "series %s\n", m->series);
+    fprintf(f, "clock %s %.9g\n", m->tsc ? "tsc" : "monotonic", m->ns_per_tick);
+    fprintf(f, "batch %" PRIu64 "\n", m->batch);
+    fprintf(f, "n %" PRIu64 "\n", n);
+    for (uint64_t i = 0; i < n; ++i) fprintf(f, "%" PRId64 "\n", v[i]);
+    if (fclose(f) != 0) { perror(path); exit(1); }
+}
+
+static int64_t* samples_load(const char* path, uint64_t* n, struct hist_meta* m) {
+    FILE* f = fopen(path, "r");
+    if (!f) { perror(path); exit(1); }
+    int version;
+    char clock_name[16];
+    if (fscanf(f, "gettimings-samples %d", &version) != 1 || version != 1 ||
+        fscanf(f, " label %255s", m->label) != 1 ||
+        fscanf(f, " series %255s", m->series) != 1 ||
+        fscanf(f, " clock %15s %lf", clock_name, &m->ns_per_tick) != 2 ||
+        fscanf(f, " batch %" SCNu64, &m->batch) != 1 ||
+        fscanf(f, " n %" SCNu64, n) != 1) {
+        fprintf(stderr, "%s: not a gettimings sample file\n", path); exit(2);
+    }
+    m->tsc = strcmp(clock_name, "tsc") == 0;
+    int64_t* v = malloc((*n ? *n : 1) * sizeof *v);
+    if (!v) { perror("malloc samples"); exit(1); }
+    for (uint64_t i = 0; i < *n; ++i) {
+        if (fscanf(f, " %" SCNd64, &v[i]) != 1) {
+            fprintf(stderr, "%s: truncated after %" PRIu64 " samples\n", path, i); exit(2);
+        }
+    }
+    fclose(f);
+    return v;
+}
+
+// ========== hardware counters ==========
+// Optional perf_event_open counters around the timed region, read as two
+// groups: hardware events (cycles leads) and software events (page faults
+// lead). Only the measuring process is counted, not forked children. When
+// hardware events cannot be opened (perf_event_paranoid, no PMU in a VM,
+// seccomp), only the software group is used and the report says why. If
+// even those are denied, as for unprivileged users at the default
+// perf_event_paranoid=2, both groups are reopened counting user space only.
+struct counter_def {
+    const char* name;
+    uint32_t    type;
+    uint64_t    config;
+};
+
+#define HW_CACHE_READ_MISS(c) \
+    ((c) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct counter_def hw_counter_defs[] = {
+    { "cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "l1d_misses",    PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    { "llc_misses",    PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+    { "dtlb_misses",   PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
+static const struct counter_def sw_counter_defs[] = {
+    { "page_faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { "context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { "cpu_migrations",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+    { "task_clock_ns",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+};
+
+#define HW_COUNTERS (sizeof hw_counter_defs / sizeof hw_counter_defs[0])
+#define SW_COUNTERS (sizeof sw_counter_defs / sizeof sw_counter_defs[0])
+#define MAX_COUNTERS (HW_COUNTERS + SW_COUNTERS)
+
+struct perf_group {
+    int n;
+    int fd[MAX_COUNTERS];
+    const struct counter_def* def[MAX_COUNTERS];
+    uint64_t mark[3 + MAX_COUNTERS];   // group read at perf_begin()
+    double   acc[MAX_COUNTERS];        // scaled counts over the regions so far
+    double   bias[MAX_COUNTERS];       // counts of an empty begin/end pair
+    bool     multiplexed;
+};
+
+struct perf_counters {
+    struct perf_group hw, sw;
+    char hw_missing[256];   // hardware events that could not be opened
+    int  hw_errno;          // first open failure
+    bool user_only;         // kernel and hypervisor excluded
+};
+
+// Scaled counts, in the order hw events then sw events.
+struct perf_sample {
+    int n;
+    const char* name[MAX_COUNTERS];
+    double value[MAX_COUNTERS];
+    bool multiplexed;
+};
+
+static int perf_open_one(const struct counter_def* d, int group_fd, bool user_only) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof a);
+    a.size = sizeof a;
+    a.type = d->type;
+    a.config = d->config;
+    a.disabled = group_fd < 0;
+    a.exclude_kernel = user_only;
+    a.exclude_hv = user_only;
+    a.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                    PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, group_fd, 0);
+}
+
+// Events that fail to open are left out and listed in missing.
+static void perf_open_group(struct perf_group* g, const struct counter_def* defs, size_t n,
+                            bool user_only, char* missing, size_t missing_len, int* first_errno)
+{
+    g->n = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int fd = perf_open_one(&defs[i], g->n ? g->fd[0] : -1, user_only);
+        if (fd < 0) {
+            size_t used = strlen(missing);
+            snprintf(missing + used, missing_len - used, "%s%s", used ? " " : "", defs[i].name);
+            if (!*first_errno) *first_errno = errno;
+            continue;
+        }
+        g->fd[g->n] = fd;
+        g->def[g->n] = &defs[i];
+        g->n++;
+    }
+}
+
+static void perf_close(struct perf_counters* pc);
+static void perf_group_calibrate(struct perf_group* g);
+
+// Returns false if not even user-space software events are available.
+static bool perf_open(struct perf_counters* pc) {
+    for (int user_only = 0; user_only < 2; ++user_only) {
+        char sw_missing[256] = "";
+        int sw_errno = 0;
+        memset(pc, 0, sizeof *pc);
+        pc->user_only = user_only;
+        perf_open_group(&pc->hw, hw_counter_defs, HW_COUNTERS, user_only,
+                        pc->hw_missing, sizeof pc->hw_missing, &pc->hw_errno);
+        perf_open_group(&pc->sw, sw_counter_defs, SW_COUNTERS, user_only,
+                        sw_missing, sizeof sw_missing, &sw_errno);
+        if (pc->sw.n > 0 || (sw_errno != EACCES && sw_errno != EPERM)) {
+            errno = sw_errno;
+            if (pc->hw.n) ioctl(pc->hw.fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            if (pc->sw.n) ioctl(pc->sw.fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            perf_group_calibrate(&pc->hw);
+            perf_group_calibrate(&pc->sw);
+            return pc->hw.n + pc->sw.n > 0;
+        }
+        perf_close(pc);
+        errno = sw_errno;
+    }
+    return false;
+}
+
+// The groups stay enabled from perf_open() on: toggling them around every
+// region made the time-based software counts (task-clock) read near 0.
+// Each region instead reads the groups before and after and adds up the
+// differences, scaled by enabled/running time when the PMU multiplexed.
+static void perf_group_read(const struct perf_group* g, uint64_t* buf) {
+    if (read(g->fd[0], buf, (3 + MAX_COUNTERS) * sizeof *buf) < 0) {
+        perror("read perf group"); exit(1);
+    }
+}
+
+static inline void perf_group_begin(struct perf_group* g) {
+    if (g->n) perf_group_read(g, g->mark);
+}
+
+static inline void perf_group_end(struct perf_group* g) {
+    if (!g->n) return;
+    uint64_t buf[3 + MAX_COUNTERS];
+    perf_group_read(g, buf);
+    uint64_t enabled = buf[1] - g->mark[1], running = buf[2] - g->mark[2];
+    double scale = running ? (double)enabled / (double)running : 0.0;
+    if (running < enabled) g->multiplexed = true;
+    for (uint64_t i = 0; i < buf[0] && i < (uint64_t)g->n; ++i)
+        g->acc[i] += (double)(buf[3 + i] - g->mark[3 + i]) * scale - g->bias[i];
+}
+
+// The second read() of a pair is partly counted, task-clock most of all;
+// the mean over empty pairs is taken off every region.
+#define PERF_BIAS_PAIRS 256
+static void perf_group_calibrate(struct perf_group* g) {
+    if (!g->n) return;
+    memset(g->acc, 0, sizeof g->acc);
+    for (int k = 0; k < PERF_BIAS_PAIRS; ++k) {
+        perf_group_begin(g);
+        perf_group_end(g);
+    }
+    for (int i = 0; i < g->n; ++i) g->bias[i] = g->acc[i] / PERF_BIAS_PAIRS;
+    memset(g->acc, 0, sizeof g->acc);
+    g->multiplexed = false;
+}
+
+static inline void perf_begin(struct perf_counters* pc) {
+    if (!pc) return;
+    perf_group_begin(&pc->hw);
+    perf_group_begin(&pc->sw);
+}
+
+static inline void perf_end(struct perf_counters* pc) {
+    if (!pc) return;
+    perf_group_end(&pc->hw);
+    perf_group_end(&pc->sw);
+}
+
+static void perf_clear(struct perf_counters* pc) {
+    memset(pc->hw.acc, 0, sizeof pc->hw.acc);
+    memset(pc->sw.acc, 0, sizeof pc->sw.acc);
+    pc->hw.multiplexed = pc->sw.multiplexed = false;
+}
+
+static void perf_collect_group(const struct perf_group* g, struct perf_sample* out) {
+    if (g->multiplexed) out->multiplexed = true;
+    for (int i = 0; i < g->n; ++i) {
+        out->name[out->n] = g->def[i]->name;
+        out->value[out->n] = g->acc[i];
+        out->n++;
+    }
+}
+
+// the counts accumulated since perf_clear()
+static void perf_read(struct perf_counters* pc, struct perf_sample* out) {
+    memset(out, 0, sizeof *out);
+    perf_collect_group(&pc->hw, out);
+    perf_collect_group(&pc->sw, out);
+}
+
+static void perf_close(struct perf_counters* pc) {
+    for (int i = 0; i < pc->hw.n; ++i) close(pc->hw.fd[i]);
+    for (int i = 0; i < pc->sw.n; ++i) close(pc->sw.fd[i]);
+}
+
+// ops: actions covered by the counts. The overhead sample, if given, is
+// the empty region and is subtracted per op.
+static void print_perf(const struct perf_counters* pc, const struct perf_sample* total,
+                       const struct perf_sample* overhead, double ops)
+{
+    if (pc->user_only) {
+        // kernel.perf_event_paranoid denied counting the kernel
+        if (pc->hw.n == 0)
+            out_str("perf_events", "user_only (no hardware events: %s)", strerror(pc->hw_errno));
+        else if (pc->hw.n < (int)HW_COUNTERS)
+            out_str("perf_events", "user_only (missing %s: %s)", pc->hw_missing,
+                    strerror(pc->hw_errno));
+        else
+            out_str("perf_events", "user_only");
+    } else if (pc->hw.n == 0) {
+        bool denied = pc->hw_errno == EACCES || pc->hw_errno == EPERM;
+        out_str("perf_events", "software_only (hardware events: %s%s)", strerror(pc->hw_errno),
+                denied ? "; check kernel.perf_event_paranoid" : "");
+    } else if (pc->hw.n < (int)HW_COUNTERS) {
+        out_str("perf_events", "partial (missing %s: %s)", pc->hw_missing, strerror(pc->hw_errno));
+    } else {
+        out_str("perf_events", "hardware");
+    }
+    if (total->multiplexed) out_num("perf_multiplexed", "1");
+    for (int i = 0; i < total->n; ++i) {
+        char key[96];
+        snprintf(key, sizeof key, "perf_%s_per_op", total->name[i]);
+        out_num(key, "%.3f", total->value[i] / ops);
+        if (overhead) {
+            snprintf(key, sizeof key, "perf_%s_per_op_subtracted", total->name[i]);
+            out_num(key, "%.3f", (total->value[i] - overhead->value[i]) / ops);
+        }
+    }
+}
+
+// ========== CPU placement ==========
+// --pin fixes the measuring process on one CPU; --child chooses where
+// children of the fork scenarios run relative to it. Forked children call
+// place_child() first thing. system() and posix_spawn() create their child
+// internally, so the parent takes the child's mask in setup_each and drops
+// it in teardown_each (see setup_child_mask()), outside the timed region;
+// it is blocked in waitpid for nearly all of the region anyway.
+enum placement { PLACE_UNPINNED, PLACE_SAME, PLACE_SIBLING, PLACE_OTHER };
+static const char* const placement_names[] = { "unpinned", "same", "sibling", "other" };
+
+static struct placement_state {
+    int            parent_cpu;   // -1 = not pinned
+    enum placement child;
+    int            child_cpu;    // -1 = child keeps the original mask
+    cpu_set_t      orig_mask;    // affinity before pinning
+} place = { -1, PLACE_UNPINNED, -1, { { 0 } } };
+
+// -1 if the topology file does not exist
+static int cpu_topology_int(int cpu, const char* what) {
+    char path[128];
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, what);
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    int v = -1;
+    if (fscanf(f, "%d", &v) != 1) v = -1;
+    fclose(f);
+    return v;
+}
+
+// SMT siblings of cpu, including itself, from a list such as "0,64" or "0-1"
+static void cpu_siblings(int cpu, cpu_set_t* out) {
+    char path[128];
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    CPU_ZERO(out);
+    CPU_SET(cpu, out);
+    FILE* f = fopen(path, "r");
+    if (!f) return;
+    int lo, hi;
+    char sep;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        if (fscanf(f, "%c", &sep) == 1 && sep == '-') {
+            if (fscanf(f, "%d", &hi) != 1) break;
+            if (fscanf(f, "%c", &sep) != 1) sep = '\n';
+        }
+        for (int c = lo; c <= hi && c < CPU_SETSIZE; ++c) CPU_SET(c, out);
+        if (sep != ',') break;
+    }
+    fclose(f);
+}
+
+static void pin_self(int cpu) {
+    cpu_set_t s;
+    CPU_ZERO(&s);
+    CPU_SET(cpu, &s);
+    if (sched_setaffinity(0, sizeof s, &s) != 0) { perror("sched_setaffinity"); exit(1); }
+}
+
+// Picks a CPU from the original mask for the child, or -1 if none fits.
+static int resolve_child_cpu(void) {
+    int p = place.parent_cpu;
+    cpu_set_t sib;
+    cpu_siblings(p, &sib);
+    int p_core = cpu_topology_int(p, "core_id");
+    int p_pkg = cpu_topology_int(p, "physical_package_id");
+    int other_pkg = -1;
+
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (c == p || !CPU_ISSET(c, &place.orig_mask)) continue;
+        bool is_sib = CPU_ISSET(c, &sib);
+        if (place.child == PLACE_SIBLING && is_sib) return c;
+        if (place.child == PLACE_OTHER && !is_sib) {
+            // prefer a different core in the same package
+            if (cpu_topology_int(c, "physical_package_id") == p_pkg &&
+                cpu_topology_int(c, "core_id") != p_core) return c;
+            if (other_pkg < 0) other_pkg = c;
+        }
+    }
+    return place.child == PLACE_OTHER ? other_pkg : -1;
+}
+
+static void placement_init(int pin_cpu, enum placement child) {
+    if (sched_getaffinity(0, sizeof place.orig_mask, &place.orig_mask) != 0) {
+        perror("sched_getaffinity"); exit(1);
+    }
+    place.child = child;
+    if (pin_cpu < 0 && child == PLACE_UNPINNED) return;
+
+    // a child placement is relative to the parent, so pin where we run
+    if (pin_cpu < 0) pin_cpu = sched_getcpu();
+    if (pin_cpu < 0 || pin_cpu >= CPU_SETSIZE || !CPU_ISSET(pin_cpu, &place.orig_mask)) {
+        fprintf(stderr, "cpu %d is not available to this process\n", pin_cpu); exit(2);
+    }
+    place.parent_cpu = pin_cpu;
+    pin_self(pin_cpu);
+
+    if (child == PLACE_SAME) {
+        place.child_cpu = pin_cpu;
+    } else if (child != PLACE_UNPINNED) {
+        place.child_cpu = resolve_child_cpu();
+        if (place.child_cpu < 0) {
+            fprintf(stderr, "no %s CPU for children of cpu %d\n", placement_names[child], pin_cpu);
+            exit(2);
+        }
+    }
+}
+
+// Children inherit the parent's single-CPU mask, which already is "same".
+static void place_child(void) {
+    if (place.parent_cpu < 0 || place.child == PLACE_SAME) return;
+    if (place.child_cpu >= 0) pin_self(place.child_cpu);
+    else sched_setaffinity(0, sizeof place.orig_mask, &place.orig_mask);
+}
+
+// The mask place_child() would set, or NULL if it leaves the mask alone,
+// for children that cannot call it but can make the syscall themselves.
+static const cpu_set_t* child_mask(void) {
+    static _Thread_local cpu_set_t one;
+    if (place.parent_cpu < 0 || place.child == PLACE_SAME) return NULL;
+    if (place.child_cpu < 0) return &place.orig_mask;
+    CPU_ZERO(&one);
+    CPU_SET(place.child_cpu, &one);
+    return &one;
+}
+
+// Puts the calling thread on the child mask, and back, around the timed
+// region of scenarios whose children cannot run place_child().
+static void setup_child_mask(void) {
+    if (place.parent_cpu < 0 || place.child == PLACE_SAME) return;
+    place_child();
+}
+static void teardown_child_mask(void) {
+    if (place.parent_cpu < 0 || place.child == PLACE_SAME) return;
+    pin_self(place.parent_cpu);
+}
+
+static void print_placement(void) {
+    if (place.parent_cpu < 0) return;
+    int p = place.parent_cpu, c = place.child_cpu;
+    out_num("parent_cpu", "%d", p);
+    out_num("parent_core", "%d", cpu_topology_int(p, "core_id"));
+    out_num("parent_package", "%d", cpu_topology_int(p, "physical_package_id"));
+    out_str("child_placement", "%s", placement_names[place.child]);
+    if (c >= 0) {
+        out_num("child_cpu", "%d", c);
+        out_num("child_core", "%d", cpu_topology_int(c, "core_id"));
+        out_num("child_package", "%d", cpu_topology_int(c, "physical_package_id"));
+    }
+}
+
+// ========== environment ==========
+// Preflight checks for conditions that make timings hard to interpret.
+// Strict mode either refuses to run or marks each result unreliable.
+// With --mlock each measuring child locks its memory and pre-faults a
+// stack reserve; sample buffers are pre-faulted and locked as they grow.
+enum strictness { STRICT_OFF, STRICT_MARK, STRICT_REFUSE };
+static const char* const strict_names[] = { "off", "mark", "refuse" };
+
+#define ENV_STACK_PREFAULT (256 * 1024)
+
+static struct {
+    int  strict;            // enum strictness
+    bool lock;
+    int  issues;
+    char issue_list[512];   // "governor=powersave;smt=on"
+} env;
+
+static void env_issue(const char* what, const char* value) {
+    size_t used = strlen(env.issue_list);
+    snprintf(env.issue_list + used, sizeof env.issue_list - used, "%s%s=%s",
+             env.issues ? ";" : "", what, value);
+    env.issues++;
+}
+
+// Load counts as noisy above half a CPU plus a tenth of the online ones.
+static void env_check(void) {
+    host_collect();
+    if (strcmp(host.governor, "unknown") != 0 && strcmp(host.governor, "performance") != 0)
+        env_issue("governor", host.governor);
+    if (strcmp(host.turbo, "on") == 0) env_issue("turbo", host.turbo);
+    if (strcmp(host.smt, "on") == 0) env_issue("smt", host.smt);
+    if (host.load1 > 0.5 + 0.1 * (double)host.ncpu_online) {
+        char v[32];
+        snprintf(v, sizeof v, "%.2f", host.load1);
+        env_issue("load1", v);
+    }
+    if (strcmp(host.cpu_max, "max") != 0 && strcmp(host.cpu_max, "unknown") != 0)
+        env_issue("cgroup_cpu_max", host.cpu_max);
+    if (env.issues) fprintf(stderr, "note: noisy environment: %s\n", env.issue_list);
+}
+
+static void env_prefault_stack(void) {
+    volatile char reserve[ENV_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof reserve; i += 4096) reserve[i] = 0;
+}
+
+static void env_lock_self(void) {
+    if (!env.lock) return;
+    env_prefault_stack();
+    if (mlockall(MCL_CURRENT) != 0)
+        fprintf(stderr, "note: mlockall failed (%s)\n", strerror(errno));
+}
+
+static void print_env(void) {
+    out_num("env_issues_count", "%d", env.issues);
+    if (env.issues) out_str("env_issues", "%s", env.issue_list);
+    if (env.strict != STRICT_OFF) out_num("reliable", "%d", env.issues == 0);
+    if (env.lock) out_num("mlock", "%d", 1);
+}
+
+// ========== measurement harness ==========
+typedef void (*action_fn)(void);
+
+struct options {
+    bool        hist;        // record into histograms instead of raw samples
+    const char* save_dir;    // write histograms here
+    const char* samples_dir; // write raw samples here
+    bool        batch;       // time batches of actions per sample
+    uint64_t    batch_k;     // fixed batch size, 0 = choose automatically
+    double      rel_err;     // adaptive: target 95% CI half-width of the median
+    double      budget_s;    // adaptive: time budget for the timed loop
+    uint64_t    max_iters;   // adaptive: hard cap, 0 = none
+    unsigned    bootstrap;   // resamples for the CIs of raw samples, 0 = none
+    bool        perf;        // read perf_event counters around the timed region
+    int         order;       // enum overhead_order
+    int64_t     warmup;      // fixed warm-up iterations, -1 = until stable
+    double      warmup_tol;  // warm-up: relative change of the window median
+    uint64_t    warmup_min;  // warm-up: never stop before this
+    uint64_t    warmup_max;  // warm-up: cap, 0 = iters/10 + 1
+    int         scale;       // enum scale_kind: run N workers concurrently
+    int         workers;     // scaling: fixed worker count, 0 = sweep
+    const char* footprints;  // footprint sweep: parent sizes, "1M,16M,..."
+    const char* fp_pages;    // footprint sweep: "4k,thp"
+    const char* fp_advice;   // footprint sweep: "none,dontfork,wipeonfork"
+    size_t      cow_size;    // CoW faults: working set mapped before fork
+    size_t      cow_pages;   // CoW faults: pages written per sample
+    size_t      snap_size;   // snapshot: heap the child serializes
+    const char* helper_dir;  // exec matrix: built helpers, NULL = next to us
+    const char* stacks;      // thread stack sweep: sizes
+    const char* guards;      // thread stack sweep: guard sizes
+};
+static struct options opt = { .budget_s = 30.0, .bootstrap = 1000,
+                               .footprints = "1M,16M,256M,1G", .fp_pages = "4k,thp",
+                               .fp_advice = "none,dontfork,wipeonfork",
+                               .cow_size = 64UL << 20, .cow_pages = 32,
+                               .snap_size = 256UL << 20,
+                               .stacks = "16K,64K,256K,1M,8M", .guards = "0,4K,64K",
+                               .warmup = -1, .warmup_tol = 0.05, .warmup_min = 48 };
+
+// An action whose work happens elsewhere, e.g. in a child process, can time
+// it there and hand the ticks back; the sample then uses them instead of
+// the clock readings around the action. Such scenarios have per-iteration
+// setup, so they are never batched.
+static _Thread_local int64_t action_ticks = -1;
+
+static inline void action_timed_itself(int64_t ticks) { action_ticks = ticks; }
+
+static inline int64_t region_ticks(uint64_t t0, uint64_t t1) {
+    if (action_ticks < 0) return (int64_t)(t1 - t0);
+    int64_t d = action_ticks;
+    action_ticks = -1;
+    return d;
+}
+
+// Destination for timed samples: a growable raw array or a histogram.
+struct sampler {
+    int64_t*     v;
+    uint64_t     cap;
+    struct hist* h;
+    uint64_t     n;
+};
+
+static void sampler_init(struct sampler* s, bool hist) {
+    memset(s, 0, sizeof *s);
+    if (hist) s->h = hist_new();
+}
+
+// grow and pre-fault so the timed loop never takes a page fault
+static void sampler_reserve(struct sampler* s, uint64_t n) {
+    if (s->h || n <= s->cap) return;
+    int64_t* v = realloc(s->v, n * sizeof *v);
+    if (!v) { perror("realloc samples"); exit(1); }
+    memset(v + s->cap, 0, (n - s->cap) * sizeof *v);
+    if (env.lock && mlock(v, n * sizeof *v) != 0)
+        fprintf(stderr, "note: mlock of samples failed (%s)\n", strerror(errno));
+    s->v = v;
+    s->cap = n;
+}
+
+static inline void sampler_add(struct sampler* s, int64_t d) {
+    if (s->h) hist_record(s->h, d);
+    else s->v[s->n] = d;
+    s->n++;
+}
+
+static void sampler_stats(struct sampler* s, struct stats* st) {
+    if (s->h) hist_stats(s->h, st);
+    else compute_stats(s->v, s->n, st);
+}
+
+static void sampler_free(struct sampler* s) {
+    free(s->v);
+    free(s->h);
+}
+
+// Distribution-free 95% CI of the median from the order statistics at
+// ranks n/2 -+ 1.96*sqrt(n)/2. Returns the half-width relative to the
+// median.
+static double median_ci_rel(const struct sampler* s) {
+    uint64_t n = s->n;
+    double half = 1.96 * sqrt((double)n) / 2.0;
+    double lo_r = floor((double)n / 2.0 - half), hi_r = ceil((double)n / 2.0 + half) + 1.0;
+    if (lo_r < 1.0 || hi_r > (double)n) return INFINITY;
+
+    double lo, med, hi;
+    if (s->h) {
+        lo  = hist_at_rank(s->h, (uint64_t)lo_r);
+        med = hist_at_rank(s->h, (n + 1) / 2);
+        hi  = hist_at_rank(s->h, (uint64_t)hi_r);
+    } else {
+        int64_t* v = malloc(n * sizeof *v);
+        if (!v) { perror("malloc"); exit(1); }
+        memcpy(v, s->v, n * sizeof *v);
+        qsort(v, n, sizeof v[0], cmp_i64);
+        lo  = (double)v[(uint64_t)lo_r - 1];
+        med = (double)v[(n + 1) / 2 - 1];
+        hi  = (double)v[(uint64_t)hi_r - 1];
+        free(v);
+    }
+    return med > 0.0 ? (hi - lo) / 2.0 / med : INFINITY;
+}
+
+// What one sample times: a single action between setup and teardown, or
+// `batch` back-to-back actions. Counters, if any, run around each timed
+// region when there is setup/teardown to exclude, else around the loop.
+struct workload {
+    action_fn setup_each, action, teardown_each;
+    uint64_t  batch;
+    struct perf_counters* perf;
+};
+
+// Batched samples must be long enough that two clock reads and the loop
+// are small next to them.
+#define BATCH_MIN_NS  1000.0
+#define BATCH_MAX_K   (1u << 24)
+
+static uint64_t time_batch(action_fn action, uint64_t k) {
+    uint64_t t0 = clock_begin();
+    for (uint64_t j = 0; j < k; ++j) {
+        action();
+        COMPILER_BARRIER();
+    }
+    return clock_end() - t0;
+}
+
+static uint64_t time_empty_batch(uint64_t k) {
+    uint64_t t0 = clock_begin();
+    for (uint64_t j = 0; j < k; ++j) {
+        // empty critical section
+        COMPILER_BARRIER();
+    }
+    return clock_end() - t0;
+}
+
+// Doubles k until the fastest of five batches lasts BATCH_MIN_NS.
+static uint64_t choose_batch(action_fn action) {
+    uint64_t k = 1;
+    for (; k < BATCH_MAX_K; k *= 2) {
+        uint64_t best = UINT64_MAX;
+        for (int r = 0; r < 5; ++r) {
+            uint64_t t = time_batch(action, k);
+            if (t < best) best = t;
+        }
+        if ((double)best * clk.ns_per_tick >= BATCH_MIN_NS) break;
+    }
+    return k;
+}
+
+// Warm-up times single actions in windows of WARMUP_WINDOW and stops once
+// the window median has stayed within opt.warmup_tol of the previous
+// window's for WARMUP_STABLE windows in a row, no earlier than
+// opt.warmup_min iterations and no later than max_n.
+#define WARMUP_WINDOW 16
+#define WARMUP_STABLE 2
+
+struct warmup {
+    uint64_t    n;
+    const char* stop;   // "converged", "max" or "fixed"
+};
+
+static struct warmup warm_up(const struct workload* w, uint64_t max_n) {
+    struct warmup res = { 0, "fixed" };
+    if (opt.warmup >= 0) max_n = (uint64_t)opt.warmup;
+    else if (opt.warmup_max) max_n = opt.warmup_max;
+    int64_t win[WARMUP_WINDOW];
+    int64_t prev = -1;
+    int stable = 0;
+    while (res.n < max_n) {
+        uint64_t k = max_n - res.n < WARMUP_WINDOW ? max_n - res.n : WARMUP_WINDOW;
+        for (uint64_t i = 0; i < k; ++i) {
+            if (w->setup_each) w->setup_each();
+            COMPILER_BARRIER();
+            uint64_t t0 = clock_begin();
+            w->action();
+            uint64_t t1 = clock_end();
+            COMPILER_BARRIER();
+            if (w->teardown_each) w->teardown_each();
+            win[i] = region_ticks(t0, t1);
+        }
+        res.n += k;
+        if (opt.warmup >= 0 || k < WARMUP_WINDOW) continue;
+        qsort(win, k, sizeof win[0], cmp_i64);
+        int64_t med = win[k / 2];
+        if (prev >= 0 && (double)llabs(med - prev) <= opt.warmup_tol * (double)prev) ++stable;
+        else stable = 0;
+        prev = med;
+        if (stable >= WARMUP_STABLE && res.n >= opt.warmup_min) {
+            res.stop = "converged";
+            return res;
+        }
+    }
+    if (opt.warmup < 0) res.stop = "max";
+    return res;
+}
+
+static void take_samples(const struct workload* w, struct sampler* s, uint64_t count) {
+    sampler_reserve(s, s->n + count);
+    if (w->batch > 1) {
+        perf_begin(w->perf);
+        for (uint64_t i = 0; i < count; ++i)
+            sampler_add(s, (int64_t)time_batch(w->action, w->batch));
+        perf_end(w->perf);
+        return;
+    }
+    bool per_region = w->setup_each || w->teardown_each;
+    if (!per_region) perf_begin(w->perf);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (w->setup_each) w->setup_each();
+        if (per_region) perf_begin(w->perf);
+        COMPILER_BARRIER();
+        uint64_t t0 = clock_begin();
+        w->action();
+        uint64_t t1 = clock_end();
+        COMPILER_BARRIER();
+        if (per_region) perf_end(w->perf);
+        if (w->teardown_each) w->teardown_each();
+        sampler_add(s, region_ticks(t0, t1));
+    }
+    if (!per_region) perf_end(w->perf);
+}
+
+static void take_overhead_samples(const struct workload* w, struct sampler* s, uint64_t count) {
+    sampler_reserve(s, s->n + count);
+    if (w->batch > 1) {
+        perf_begin(w->perf);
+        for (uint64_t i = 0; i < count; ++i)
+            sampler_add(s, (int64_t)time_empty_batch(w->batch));
+        perf_end(w->perf);
+        return;
+    }
+    bool per_region = w->setup_each || w->teardown_each;
+    if (!per_region) perf_begin(w->perf);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (w->setup_each) w->setup_each();
+        if (per_region) perf_begin(w->perf);
+        COMPILER_BARRIER();
+        uint64_t t0 = clock_begin();
+        // empty critical section
+        COMPILER_BARRIER();
+        uint64_t t1 = clock_end();
+        if (per_region) perf_end(w->perf);
+        if (w->teardown_each) w->teardown_each();
+        sampler_add(s, (int64_t)(t1 - t0));
+    }
+    if (!per_region) perf_end(w->perf);
+}
+
+// ---------- interleaved overhead ----------
+// The empty-region baseline can run after all samples (trailing), or be
+// interleaved with them: each pair times the action and the empty region
+// back to back, in alternating or random order, so frequency and cache
+// drift hit both alike. The per-pair differences are kept as their own
+// series. Counters in interleaved runs cover the action regions only.
+enum overhead_order { ORDER_ALTERNATE, ORDER_RANDOM, ORDER_TRAILING };
+static const char* const order_names[] = { "alternate", "random", "trailing" };
+
+// Welford mean and variance, for paired differences in histogram runs,
+// which cannot hold negative values.
+struct running {
+    uint64_t n;
+    double   mean, m2;
+};
+
+static inline void running_add(struct running* r, double x) {
+    double d = x - r->mean;
+    r->n++;
+    r->mean += d / (double)r->n;
+    r->m2 += d * (x - r->mean);
+}
+
+static int64_t sample_action(const struct workload* w) {
+    if (w->batch > 1) {
+        perf_begin(w->perf);
+        int64_t d = (int64_t)time_batch(w->action, w->batch);
+        perf_end(w->perf);
+        return d;
+    }
+    if (w->setup_each) w->setup_each();
+    perf_begin(w->perf);
+    COMPILER_BARRIER();
+    uint64_t t0 = clock_begin();
+    w->action();
+    uint64_t t1 = clock_end();
+    COMPILER_BARRIER();
+    perf_end(w->perf);
+    if (w->teardown_each) w->teardown_each();
+    return region_ticks(t0, t1);
+}
+
+static int64_t sample_empty(const struct workload* w) {
+    if (w->batch > 1) return (int64_t)time_empty_batch(w->batch);
+    if (w->setup_each) w->setup_each();
+    COMPILER_BARRIER();
+    uint64_t t0 = clock_begin();
+    // empty critical section
+    COMPILER_BARRIER();
+    uint64_t t1 = clock_end();
+    if (w->teardown_each) w->teardown_each();
+    return (int64_t)(t1 - t0);
+}
+
+// Everything one measure() call records.
+struct run {
+    const struct workload* w;
+    bool            interleaved;
+    struct sampler  total, overhead;
+    struct sampler  paired;        // raw runs: action minus empty, per pair
+    struct running  paired_run;    // histogram runs
+    uint64_t        rng;
+};
+
+static void take_pairs(struct run* r, uint64_t count) {
+    sampler_reserve(&r->total, r->total.n + count);
+    sampler_reserve(&r->overhead, r->overhead.n + count);
+    if (!r->total.h) sampler_reserve(&r->paired, r->paired.n + count);
+    for (uint64_t i = 0; i < count; ++i) {
+        bool action_first = opt.order == ORDER_RANDOM ? (rng_next(&r->rng) & 1)
+                                                      : ((r->total.n & 1) == 0);
+        int64_t a, e;
+        if (action_first) {
+            a = sample_action(r->w);
+            e = sample_empty(r->w);
+        } else {
+            e = sample_empty(r->w);
+            a = sample_action(r->w);
+        }
+        sampler_add(&r->total, a);
+        sampler_add(&r->overhead, e);
+        if (r->total.h) running_add(&r->paired_run, (double)(a - e));
+        else sampler_add(&r->paired, a - e);
+    }
+}
+
+static void run_round(struct run* r, uint64_t count) {
+    if (r->interleaved) take_pairs(r, count);
+    else take_samples(r->w, &r->total, count);
+}
+
+// Adaptive mode: rounds of samples growing by half the total so far, until
+// the median's CI meets opt.rel_err, the budget runs out, or max_iters.
+// Each round is sized from the observed wall time per sample so the
+// budget is not overshot by much.
+#define ADAPTIVE_FIRST_ROUND 100
+
+static const char* take_samples_adaptive(struct run* r) {
+    struct sampler* s = &r->total;
+    uint64_t start = nsecs_now();
+    double budget_ns = opt.budget_s * 1e9;
+    uint64_t round = ADAPTIVE_FIRST_ROUND;
+    for (;;) {
+        if (opt.max_iters && s->n + round > opt.max_iters) round = opt.max_iters - s->n;
+        run_round(r, round);
+
+        if (median_ci_rel(s) <= opt.rel_err) return "target";
+        if (opt.max_iters && s->n >= opt.max_iters) return "max_iters";
+        double spent = (double)(nsecs_now() - start);
+        if (spent >= budget_ns) return "budget";
+
+        double per_sample = spent / (double)s->n;
+        double fits = (budget_ns - spent) / per_sample;
+        round = s->n / 2 + 1;
+        if ((double)round > fits) round = fits >= 1.0 ? (uint64_t)fits : 1;
+    }
+}
+
+// ========== scaling mode ==========
+// --scale=threads|procs runs the scenario in N workers at once, each on
+// its own CPU from the original affinity mask, released together by a
+// start gate. Samples from all workers are pooled for the latency stats;
+// throughput is all actions over the time from the gate to the last
+// worker finishing. Overhead subtraction and perf counters are per
+// process concepts and are skipped here.
+enum scale_kind { SCALE_NONE, SCALE_THREADS, SCALE_PROCS };
+
+// Lives in a MAP_SHARED mapping so process workers see it too; the
+// per-worker samples or histograms follow it in the same mapping.
+struct scale_shared {
+    atomic_int ready;
+    atomic_int go;
+    uint64_t   t_end[];   // nsecs_now() when each worker finished
+};
+
+struct scale_worker {
+    const struct workload* w;
+    struct scale_shared*   sh;
+    struct sampler         s;
+    uint64_t               iters;
+    int                    idx, cpu;
+};
+
+struct scale_point {
+    int          workers;
+    double       ops_per_s;
+    struct stats st;
+};
+
+static void scale_worker_run(struct scale_worker* sw) {
+    if (sw->cpu >= 0) pin_self(sw->cpu);
+    warm_up(sw->w, sw->iters / 10 + 1);
+    atomic_fetch_add(&sw->sh->ready, 1);
+    while (!atomic_load(&sw->sh->go)) sched_yield();
+    take_samples(sw->w, &sw->s, sw->iters);
+    sw->sh->t_end[sw->idx] = nsecs_now();
+}
+
+static void* scale_thread_main(void* arg) {
+    scale_worker_run(arg);
+    return NULL;
+}
+
+static void run_scale_point(const struct workload* w, int n, uint64_t iters,
+                            const int* cpus, int ncpus, struct scale_point* out)
+{
+    size_t head = (sizeof(struct scale_shared) + (size_t)n * sizeof(uint64_t) + 63) & ~(size_t)63;
+    size_t per = opt.hist ? sizeof(struct hist) : iters * sizeof(int64_t);
+    size_t len = head + (size_t)n * per;
+    char* map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) { perror("mmap"); exit(1); }
+    memset(map, 0, len);
+    struct scale_shared* sh = (struct scale_shared*)map;
+
+    struct scale_worker* sw = calloc((size_t)n, sizeof *sw);
+    pthread_t* th = calloc((size_t)n, sizeof *th);
+    pid_t* pids = calloc((size_t)n, sizeof *pids);
+    if (!sw || !th || !pids) { perror("calloc"); exit(1); }
+    for (int i = 0; i < n; ++i) {
+        sw[i] = (struct scale_worker){ .w = w, .sh = sh, .iters = iters, .idx = i,
+                                       .cpu = n <= ncpus ? cpus[i] : -1 };
+        if (opt.hist) {
+            sw[i].s.h = (struct hist*)(map + head + (size_t)i * per);
+            hist_init(sw[i].s.h);
+        } else {
+            sw[i].s.v = (int64_t*)(map + head + (size_t)i * per);
+            sw[i].s.cap = iters;
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (opt.scale == SCALE_THREADS) {
+            int e = pthread_create(&th[i], NULL, scale_thread_main, &sw[i]);
+            if (e) { errno = e; perror("pthread_create"); exit(1); }
+        } else {
+            pids[i] = fork();
+            if (pids[i] < 0) { perror("fork"); exit(1); }
+            if (pids[i] == 0) { scale_worker_run(&sw[i]); _exit(0); }
+        }
+    }
+    while (atomic_load(&sh->ready) < n) sched_yield();
+    uint64_t t_go = nsecs_now();
+    atomic_store(&sh->go, 1);
+    for (int i = 0; i < n; ++i) {
+        if (opt.scale == SCALE_THREADS) {
+            pthread_join(th[i], NULL);
+        } else {
+            int st;
+            if (waitpid(pids[i], &st, 0) < 0) { perror("waitpid"); exit(1); }
+            if (!WIFEXITED(st) || WEXITSTATUS(st) != 0) {
+                fprintf(stderr, "scaling worker %d failed\n", i); exit(1);
+            }
+        }
+    }
+
+    uint64_t t_end = t_go;
+    for (int i = 0; i < n; ++i) if (sh->t_end[i] > t_end) t_end = sh->t_end[i];
+    double ops = (double)n * (double)iters * (double)w->batch;
+    out->workers = n;
+    out->ops_per_s = ops / ((double)(t_end - t_go) * 1e-9);
+
+    // pool the workers' samples; raw slices are contiguous in the mapping
+    if (opt.hist) {
+        for (int i = 1; i < n; ++i) hist_merge(sw[0].s.h, sw[i].s.h);
+        hist_stats(sw[0].s.h, &out->st);
+    } else {
+        compute_stats((int64_t*)(map + head), (uint64_t)n * iters, &out->st);
+    }
+    stats_per_op(&out->st, w->batch);
+
+    free(sw);
+    free(th);
+    free(pids);
+    munmap(map, len);
+}
+
+// Worker counts 1, 2, 4, ... up to and including the CPU count, unless
+// --workers gave a single count.
+static void measure_scaling(const char* label, const struct workload* w, uint64_t iters) {
+    int cpus[CPU_SETSIZE], ncpus = 0;
+    for (int c = 0; c < CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, &place.orig_mask)) cpus[ncpus++] = c;
+
+    int counts[64], npoints = 0;
+    if (opt.workers > 0) {
+        counts[npoints++] = opt.workers;
+    } else {
+        for (int k = 1; k < ncpus; k *= 2) counts[npoints++] = k;
+        counts[npoints++] = ncpus;
+    }
+
+    struct scale_point pts[64];
+    for (int p = 0; p < npoints; ++p) {
+        run_scale_point(w, counts[p], iters, cpus, ncpus, &pts[p]);
+        out_begin(label);
+        out_str("scale_mode", "%s", opt.scale == SCALE_THREADS ? "threads" : "procs");
+        out_num("workers", "%d", counts[p]);
+        out_num("workers_pinned", "%d", counts[p] <= ncpus);
+        out_num("iters_per_worker", "%" PRIu64, iters);
+        print_env();
+        out_str("clock", "%s", clk.kind == CLOCK_KIND_TSC ? "tsc" : "monotonic");
+        if (opt.batch) out_num("batch", "%" PRIu64, w->batch);
+        out_num("throughput_ops_per_s", "%.1f", pts[p].ops_per_s);
+        print_stats("total", &pts[p].st);
+        out_end();
+    }
+
+    // The knee is the last worker count that still gets SCALE_KNEE_EFF of
+    // linear speedup over one worker.
+    if (npoints < 2) return;
+    const double SCALE_KNEE_EFF = 0.75;
+    double base = pts[0].ops_per_s / pts[0].workers;
+    int knee = pts[0].workers;
+    bool past_knee = false;
+    // Text gets a table; structured formats get one result whose keys
+    // carry the worker count.
+    char name[300];
+    snprintf(name, sizeof name, "%s_scaling", label);
+    out_begin(name);
+    if (out.fmt == FORMAT_TEXT)
+        printf("workers,throughput_ops_per_s,speedup,efficiency,p50_%s,p99_%s\n",
+               report.unit, report.unit);
+    for (int p = 0; p < npoints; ++p) {
+        double speedup = pts[p].ops_per_s / base;
+        double eff = speedup / pts[p].workers;
+        if (eff >= SCALE_KNEE_EFF && !past_knee) knee = pts[p].workers;
+        else past_knee = true;
+        if (out.fmt == FORMAT_TEXT) {
+            printf("%d,%.1f,%.2f,%.3f,%.3f,%.3f\n", pts[p].workers, pts[p].ops_per_s, speedup,
+                   eff, pts[p].st.p50 * report.per_tick, pts[p].st.p99 * report.per_tick);
+            continue;
+        }
+        char key[64];
+        snprintf(key, sizeof key, "w%d_throughput_ops_per_s", pts[p].workers);
+        out_num(key, "%.1f", pts[p].ops_per_s);
+        snprintf(key, sizeof key, "w%d_speedup", pts[p].workers);
+        out_num(key, "%.2f", speedup);
+        snprintf(key, sizeof key, "w%d_efficiency", pts[p].workers);
+        out_num(key, "%.3f", eff);
+        snprintf(key, sizeof key, "w%d_p50", pts[p].workers);
+        out_stat(key, "total", pts[p].st.p50);
+        snprintf(key, sizeof key, "w%d_p99", pts[p].workers);
+        out_stat(key, "total", pts[p].st.p99);
+    }
+    out_num("knee_workers", "%d", knee);
+    out_str("knee_rule", "efficiency>=%.2f", SCALE_KNEE_EFF);
+    out_end();
+}
+
+// Returns the per-op stats of the total series, zeroed in scaling mode.
+static struct stats measure(const char* label,
+                            action_fn setup_each, action_fn action, action_fn teardown_each,
+                            uint64_t iters, bool subtract_overhead)
+{
+    if (iters == 0) { fprintf(stderr, "iters must be > 0\n"); exit(2); }
+
+    struct workload w = { setup_each, action, teardown_each, 1, NULL };
+    bool scaling = opt.scale != SCALE_NONE;
+    struct warmup wu = { 0, NULL };
+    if (!scaling) wu = warm_up(&w, iters/10 + 1);
+
+    // Batching times k back-to-back actions per sample and an empty loop of
+    // the same k as the baseline. Per-iteration setup/teardown would have to
+    // run inside the batch, so those scenarios keep single-action samples.
+    if (opt.batch) {
+        if (setup_each || teardown_each)
+            fprintf(stderr, "note: %s has per-iteration setup/teardown, not batching\n", label);
+        else
+            w.batch = opt.batch_k ? opt.batch_k : choose_batch(action);
+    }
+    if (scaling) {
+        measure_scaling(label, &w, iters);
+        return (struct stats){ 0 };
+    }
+
+    struct run r = { .w = &w, .rng = 0xC0FFEE,
+                     .interleaved = subtract_overhead && opt.order != ORDER_TRAILING };
+    struct sampler* samples = &r.total;
+    struct sampler* overhead = &r.overhead;
+    sampler_init(samples, opt.hist);
+    sampler_init(overhead, opt.hist);
+    sampler_init(&r.paired, false);
+
+    struct perf_counters pc;
+    struct perf_sample perf_total, perf_overhead;
+    if (opt.perf) {
+        if (perf_open(&pc)) w.perf = &pc;
+        else fprintf(stderr, "note: perf_event_open unavailable (%s)\n", strerror(errno));
+    }
+
+    // timed
+    const char* stop = NULL;
+    if (w.perf) perf_clear(w.perf);
+    if (opt.rel_err > 0.0) stop = take_samples_adaptive(&r);
+    else run_round(&r, iters);
+    iters = samples->n;
+    double ci_rel = median_ci_rel(samples);
+    if (w.perf) perf_read(w.perf, &perf_total);
+
+    bool trailing = subtract_overhead && !r.interleaved;
+    if (trailing) {
+        if (w.perf) perf_clear(w.perf);
+        take_overhead_samples(&w, overhead, iters);
+        if (w.perf) perf_read(w.perf, &perf_overhead);
+    }
+
+    struct stats st_total, st_overhead, st_paired;
+    if (opt.hist && opt.save_dir) {
+        struct hist_meta m = { .tsc = clk.kind == CLOCK_KIND_TSC,
+                               .ns_per_tick = clk.ns_per_tick, .batch = w.batch };
+        snprintf(m.label, sizeof m.label, "%s", label);
+        strcpy(m.series, "total");
+        hist_save(samples->h, opt.save_dir, &m);
+        if (subtract_overhead) {
+            strcpy(m.series, "overhead");
+            hist_save(overhead->h, opt.save_dir, &m);
+        }
+    }
+    if (!opt.hist && opt.samples_dir) {
+        struct hist_meta m = { .tsc = clk.kind == CLOCK_KIND_TSC,
+                               .ns_per_tick = clk.ns_per_tick, .batch = w.batch };
+        snprintf(m.label, sizeof m.label, "%s", label);
+        strcpy(m.series, "total");
+        samples_save(samples->v, samples->n, opt.samples_dir, &m);
+        if (subtract_overhead) {
+            strcpy(m.series, "overhead");
+            samples_save(overhead->v, overhead->n, opt.samples_dir, &m);
+        }
+    }
+    sampler_stats(samples, &st_total);
+    if (!samples->h) bootstrap_ci(samples->v, samples->n, opt.bootstrap, &st_total);
+    if (subtract_overhead) sampler_stats(overhead, &st_overhead);
+    stats_per_op(&st_total, w.batch);
+    if (subtract_overhead) stats_per_op(&st_overhead, w.batch);
+    if (r.paired.n) {
+        sampler_stats(&r.paired, &st_paired);
+        bootstrap_ci(r.paired.v, r.paired.n, opt.bootstrap, &st_paired);
+        stats_per_op(&st_paired, w.batch);
+    }
+
+    out_begin(label);
+    out_num("iters", "%" PRIu64, iters);
+    out_num("warmup_iters", "%" PRIu64, wu.n);
+    out_str("warmup_stop", "%s", wu.stop);
+    if (out.fmt != FORMAT_TEXT) out_num("subtract_overhead", "%d", subtract_overhead);
+    if (stop) {
+        out_num("target_rel_err", "%g", opt.rel_err);
+        out_str("stop_reason", "%s", stop);
+    }
+    out_num("median_ci95_rel_err", "%.4f", ci_rel);
+    out_str("clock", "%s", clk.kind == CLOCK_KIND_TSC ? "tsc" : "monotonic");
+    if (clk.kind == CLOCK_KIND_TSC) out_num("tsc_ghz", "%.6f", 1.0 / clk.ns_per_tick);
+    print_placement();
+    print_env();
+    if (opt.batch) out_num("batch", "%" PRIu64, w.batch);
+    if (subtract_overhead) out_str("overhead_order", "%s", order_names[opt.order]);
+    print_stats("total", &st_total);
+    if (subtract_overhead) {
+        print_stats("overhead", &st_overhead);
+        print_stats_subtracted(&st_total, &st_overhead);
+    }
+    if (r.paired.n) {
+        print_stats("paired", &st_paired);
+    } else if (r.paired_run.n) {
+        // histogram run: mean of the differences with a normal CI
+        double k = 1.0 / (double)w.batch;
+        double se = r.paired_run.n > 1
+                  ? sqrt(r.paired_run.m2 / (double)(r.paired_run.n - 1) / (double)r.paired_run.n)
+                  : 0.0;
+        out_stat("mean", "paired", r.paired_run.mean * k);
+        out_stat("mean_ci95_lo", "paired", (r.paired_run.mean - 1.96 * se) * k);
+        out_stat("mean_ci95_hi", "paired", (r.paired_run.mean + 1.96 * se) * k);
+    }
+    print_stats_method(&st_total, opt.bootstrap);
+    if (w.perf) {
+        print_perf(w.perf, &perf_total, trailing ? &perf_overhead : NULL,
+                   (double)iters * (double)w.batch);
+        perf_close(w.perf);
+    }
+    out_end();
+
+    sampler_free(samples);
+    sampler_free(overhead);
+    sampler_free(&r.paired);
+    return st_total;
+}
+
+// Combine histograms saved by --save-hist from separate runs or processes.
+// All inputs must be the same series with the same tick length and batch
+// size; the result can be saved again.
+static int merge_main(int nfiles, char** files, bool cycles) {
+    struct hist* acc = hist_new();
+    struct hist* h = hist_new();
+    struct hist_meta m, first;
+
+    for (int i = 0; i < nfiles; ++i) {
+        hist_load(files[i], h, &m);
+        if (i == 0) {
+            first = m;
+        } else if (strcmp(m.series, first.series) != 0) {
+            fprintf(stderr, "%s: series %s does not match %s\n", files[i], m.series, first.series);
+            return 2;
+        } else if (m.tsc != first.tsc || fabs(m.ns_per_tick / first.ns_per_tick - 1.0) > 1e-3) {
+            fprintf(stderr, "%s: tick length %.6g ns does not match %.6g ns\n",
+                    files[i], m.ns_per_tick, first.ns_per_tick);
+            return 2;
+        } else if (m.batch != first.batch) {
+            fprintf(stderr, "%s: batch %" PRIu64 " does not match %" PRIu64 "\n",
+                    files[i], m.batch, first.batch);
+            return 2;
+        } else if (strcmp(m.label, first.label) != 0) {
+            fprintf(stderr, "warning: merging %s into %s\n", m.label, first.label);
+        }
+        hist_merge(acc, h);
+    }
+    if (acc->total == 0) { fprintf(stderr, "merged histogram is empty\n"); return 2; }
+
+    report_init(cycles, first.ns_per_tick, first.tsc);
+    struct stats st;
+    hist_stats(acc, &st);
+    stats_per_op(&st, first.batch);
+    out_begin(first.label);
+    out_num("merged_files", "%d", nfiles);
+    out_num("iters", "%" PRIu64, acc->total);
+    if (first.batch > 1) out_num("batch", "%" PRIu64, first.batch);
+    print_stats(first.series, &st);
+    out_end();
+    if (opt.save_dir) hist_save(acc, opt.save_dir, &first);
+
+    free(acc);
+    free(h);
+    return 0;
+}
+
+// ========== comparison ==========
+// Two result sets (directories written by --save-hist or --save-samples)
+// are compared file by file. Each series is reduced to its distinct values
+// in ns per operation with counts, one per bin for histograms, so raw
+// samples and histograms go through the same code.
+struct dist {
+    double*   v;
+    uint64_t* c;
+    size_t    k;
+    uint64_t  n;
+};
+
+static bool has_suffix(const char* s, const char* suffix) {
+    size_t ls = strlen(s), lx = strlen(suffix);
+    return ls >= lx && strcmp(s + ls - lx, suffix) == 0;
+}
+
+static void dist_push(struct dist* d, double v, uint64_t c) {
+    d->v[d->k] = v;
+    d->c[d->k++] = c;
+    d->n += c;
+}
+
+static void dist_load(const char* path, struct dist* d, struct hist_meta* m) {
+    memset(d, 0, sizeof *d);
+    if (has_suffix(path, ".hist")) {
+        struct hist* h = hist_new();
+        hist_load(path, h, m);
+        double scale = m->ns_per_tick / (double)m->batch;
+        d->v = malloc(HIST_LEN * sizeof *d->v);
+        d->c = malloc(HIST_LEN * sizeof *d->c);
+        if (!d->v || !d->c) { perror("malloc dist"); exit(1); }
+        for (uint32_t i = 0; i < HIST_LEN; ++i)
+            if (h->counts[i]) dist_push(d, hist_mid(i) * scale, h->counts[i]);
+        free(h);
+        return;
+    }
+    uint64_t n;
+    int64_t* v = samples_load(path, &n, m);
+    double scale = m->ns_per_tick / (double)m->batch;
+    qsort(v, n, sizeof *v, cmp_i64);
+    d->v = malloc((n ? n : 1) * sizeof *d->v);
+    d->c = malloc((n ? n : 1) * sizeof *d->c);
+    if (!d->v || !d->c) { perror("malloc dist"); exit(1); }
+    for (uint64_t i = 0; i < n; ) {
+        uint64_t j = i;
+        while (j < n && v[j] == v[i]) ++j;
+        dist_push(d, (double)v[i] * scale, j - i);
+        i = j;
+    }
+    free(v);
+}
+
+static void dist_free(struct dist* d) {
+    free(d->v);
+    free(d->c);
+}
+
+// value at 1-based rank
+static double dist_at_rank(const struct dist* d, uint64_t rank) {
+    uint64_t seen = 0;
+    for (size_t i = 0; i < d->k; ++i) {
+        seen += d->c[i];
+        if (seen >= rank) return d->v[i];
+    }
+    return d->v[d->k - 1];
+}
+
+// Median with its order-statistic 95% CI (as in hist_robust), and the
+// standard error of log(median) that CI implies; NAN when n is too small.
+static double dist_median(const struct dist* d, double* se_log) {
+    double n = (double)d->n;
+    double med = dist_at_rank(d, (d->n + 1) / 2);
+    double half = 1.96 * sqrt(n) / 2.0;
+    double lo_r = floor(n / 2.0 - half), hi_r = ceil(n / 2.0 + half) + 1.0;
+    *se_log = NAN;
+    if (lo_r >= 1.0 && hi_r <= n) {
+        double lo = dist_at_rank(d, (uint64_t)lo_r), hi = dist_at_rank(d, (uint64_t)hi_r);
+        if (lo > 0.0) *se_log = (log(hi) - log(lo)) / (2.0 * 1.96);
+    }
+    return med;
+}
+
+struct comparison {
+    double med_a, med_b;
+    double change, change_lo, change_hi;   // median B / median A - 1
+    double u, z, p;                        // Mann-Whitney U of B, normal approx.
+    double delta;                          // Cliff's delta, > 0: B slower
+};
+
+// Mann-Whitney U over the merged value groups, with mid-ranks for ties and
+// the tie-corrected normal approximation. Cliff's delta follows from U.
+static void compare_dists(const struct dist* a, const struct dist* b, struct comparison* r) {
+    double na = (double)a->n, nb = (double)b->n, n = na + nb;
+    double rank_b = 0.0, ties = 0.0, below = 0.0;
+    size_t i = 0, j = 0;
+    while (i < a->k || j < b->k) {
+        double v = i < a->k && (j >= b->k || a->v[i] <= b->v[j]) ? a->v[i] : b->v[j];
+        double ca = 0.0, cb = 0.0;
+        if (i < a->k && a->v[i] == v) ca = (double)a->c[i++];
+        if (j < b->k && b->v[j] == v) cb = (double)b->c[j++];
+        double t = ca + cb;
+        rank_b += cb * (below + (t + 1.0) / 2.0);
+        ties += t * t * t - t;
+        below += t;
+    }
+    r->u = rank_b - nb * (nb + 1.0) / 2.0;
+    double sigma = sqrt(na * nb / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0))));
+    r->z = sigma > 0.0 ? (r->u - na * nb / 2.0) / sigma : 0.0;
+    r->p = erfc(fabs(r->z) / sqrt(2.0));
+    r->delta = 2.0 * r->u / (na * nb) - 1.0;
+
+    double se_a, se_b;
+    r->med_a = dist_median(a, &se_a);
+    r->med_b = dist_median(b, &se_b);
+    r->change = r->change_lo = r->change_hi = NAN;
+    if (r->med_a > 0.0 && r->med_b > 0.0) {
+        double lr = log(r->med_b / r->med_a), se = sqrt(se_a * se_a + se_b * se_b);
+        r->change = exp(lr) - 1.0;
+        r->change_lo = exp(lr - 1.96 * se) - 1.0;
+        r->change_hi = exp(lr + 1.96 * se) - 1.0;
+    }
+}
+
+// Romano et al. thresholds for |delta|
+static const char* effect_size(double delta) {
+    double d = fabs(delta);
+    return d < 0.147 ? "negligible" : d < 0.33 ? "small" : d < 0.474 ? "medium" : "large";
+}
+
+static int cmp_str(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// A series regresses when B is slower with p < alpha and its median moved
+// by more than the threshold. Returns 1 if any did.
+static int compare_main(const char* dir_a, const char* dir_b, double threshold, double alpha) {
+    DIR* dir = opendir(dir_a);
+    if (!dir) { perror(dir_a); return 2; }
+    char** names = NULL;
+    size_t nnames = 0;
+    for (struct dirent* e; (e = readdir(dir)); ) {
+        if (!has_suffix(e->d_name, ".hist") && !has_suffix(e->d_name, ".samples")) continue;
+        names = realloc(names, (nnames + 1) * sizeof *names);
+        if (!names || !(names[nnames] = strdup(e->d_name))) { perror("malloc"); exit(1); }
+        ++nnames;
+    }
+    closedir(dir);
+    qsort(names, nnames, sizeof *names, cmp_str);
+
+    struct row {
+        char              name[520];
+        struct comparison c;
+        const char*       verdict;
+    }* rows = calloc(nnames ? nnames : 1, sizeof *rows);
+    if (!rows) { perror("calloc"); exit(1); }
+    size_t nrows = 0;
+    int regressions = 0;
+    for (size_t f = 0; f < nnames; ++f) {
+        // B may hold the same series in the other format
+        char pa[PATH_MAX], pb[PATH_MAX];
+        snprintf(pa, sizeof pa, "%s/%s", dir_a, names[f]);
+        snprintf(pb, sizeof pb, "%s/%s", dir_b, names[f]);
+        if (access(pb, R_OK) != 0) {
+            size_t stem = strlen(names[f]) - (has_suffix(names[f], ".hist") ? 5 : 8);
+            snprintf(pb, sizeof pb, "%s/%.*s%s", dir_b, (int)stem, names[f],
+                     has_suffix(names[f], ".hist") ? ".samples" : ".hist");
+        }
+        if (access(pb, R_OK) != 0) {
+            fprintf(stderr, "note: %s only in %s\n", names[f], dir_a);
+            continue;
+        }
+        struct dist a, b;
+        struct hist_meta ma, mb;
+        dist_load(pa, &a, &ma);
+        dist_load(pb, &b, &mb);
+        if (a.n == 0 || b.n == 0) {
+            fprintf(stderr, "note: %s is empty\n", names[f]);
+            dist_free(&a);
+            dist_free(&b);
+            continue;
+        }
+        struct row* r = &rows[nrows++];
+        snprintf(r->name, sizeof r->name, "%s_%s", ma.label, ma.series);
+        compare_dists(&a, &b, &r->c);
+        bool significant = r->c.p < alpha;
+        if (significant && r->c.change > threshold) {
+            r->verdict = "regression";
+            ++regressions;
+        } else if (significant && r->c.change < -threshold) {
+            r->verdict = "improvement";
+        } else {
+            r->verdict = "unchanged";
+        }
+
+        out_begin(r->name);
+        out_num("n_a", "%" PRIu64, a.n);
+        out_num("n_b", "%" PRIu64, b.n);
+        out_num("median_ns_a", "%.3f", r->c.med_a);
+        out_num("median_ns_b", "%.3f", r->c.med_b);
+        out_num("median_change", "%.4f", r->c.change);
+        out_num("median_change_ci95_lo", "%.4f", r->c.change_lo);
+        out_num("median_change_ci95_hi", "%.4f", r->c.change_hi);
+        out_num("mann_whitney_u", "%.1f", r->c.u);
+        out_num("mann_whitney_z", "%.3f", r->c.z);
+        out_num("p_value", "%.3g", r->c.p);
+        out_num("cliffs_delta", "%.4f", r->c.delta);
+        out_str("effect_size", "%s", effect_size(r->c.delta));
+        out_num("threshold", "%g", threshold);
+        out_num("alpha", "%g", alpha);
+        out_str("verdict", "%s", r->verdict);
+        out_end();
+        dist_free(&a);
+        dist_free(&b);
+    }
+    if (out.fmt == FORMAT_TEXT && nrows) {
+        printf("series,median_ns_a,median_ns_b,change,ci95_lo,ci95_hi,p_value,cliffs_delta,verdict\n");
+        for (size_t i = 0; i < nrows; ++i) {
+            const struct row* r = &rows[i];
+            printf("%s,%.3f,%.3f,%+.2f%%,%+.2f%%,%+.2f%%,%.3g,%.3f,%s\n", r->name, r->c.med_a,
+                   r->c.med_b, 100.0 * r->c.change, 100.0 * r->c.change_lo,
+                   100.0 * r->c.change_hi, r->c.p, r->c.delta, r->verdict);
+        }
+    }
+    if (nrows == 0) fprintf(stderr, "no series in common between %s and %s\n", dir_a, dir_b);
+
+    for (size_t f = 0; f < nnames; ++f) free(names[f]);
+    free(names);
+    free(rows);
+    if (nrows == 0) return 2;
+    return regressions ? 1 : 0;
+}
+
+// ========== scenarios ==========
+
+// 1) empty function
+static void act_call_empty(void) { empty_function(); }
+
+// 2) drand48
+static void act_drand48(void) { sink_double = drand48(); }
+
+// 3) getppid
+static void act_getppid(void) { sink_u64 = (uint64_t)getppid(); }
+
+// Scenario state is per thread so --scale=threads workers do not share it.
+// drand48() itself keeps one process-wide state; that is what is measured.
+
+// 4) fork() return in parent
+static _Thread_local pid_t last_child = -1;
+static void act_fork_parent_return(void) {
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) { place_child(); _exit(0); }
+    last_child = p;
+    sink_u64 ^= (uint64_t)p;
+}
+static void teardown_wait_for_last_child(void) {
+    if (last_child > 0) {
+        int st;
+        if (waitpid(last_child, &st, 0) < 0) { perror("waitpid"); exit(1); }
+        last_child = -1;
+    }
+}
+
+// 5) waitpid already-terminated
+static _Thread_local pid_t ready_zombie = -1;
+static void setup_waitpid_ready(void) {
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) { place_child(); _exit(0); }
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 2*1000*1000 }; // 2 ms
+    nanosleep(&ts, NULL);
+    ready_zombie = p;
+}
+static void act_waitpid_ready(void) {
+    int st;
+    pid_t r = waitpid(ready_zombie, &st, 0);
+    if (r != ready_zombie) { perror("waitpid"); exit(1); }
+    sink_u64 ^= (uint64_t)r;
+}
+// NEW: teardown that reaps child if needed
+static void teardown_wait_ready(void) {
+    if (ready_zombie > 0) {
+        int st;
+        pid_t r = waitpid(ready_zombie, &st, 0);
+        if (r < 0 && errno != ECHILD) { perror("waitpid"); exit(1); }
+        ready_zombie = -1;
+    }
+}
+
+// 6) child exits + waitpid
+static void act_fork_child_exit_wait(void) {
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) { place_child(); _exit(0); }
+    int st;
+    if (waitpid(p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    sink_u64 ^= (uint64_t)st;
+}
+
+// 9) vfork() child exits + waitpid: no page-table copy, parent suspended
+// until the child exits. The child only calls place_child() and _exit().
+static void act_vfork_child_exit_wait(void) {
+    pid_t p = vfork();
+    if (p < 0) { perror("vfork"); exit(1); }
+    if (p == 0) { place_child(); _exit(0); }
+    int st;
+    if (waitpid(p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    sink_u64 ^= (uint64_t)st;
+}
+
+// 10) clone(CLONE_VM | CLONE_VFORK) on a private stack, as posix_spawn does.
+// The parent is suspended while the child runs, so one stack per thread
+// is enough.
+#define CHILD_STACK_SIZE (64 * 1024)
+static _Thread_local char* child_stack;
+
+static char* get_child_stack(void) {
+    if (!child_stack) {
+        child_stack = mmap(NULL, CHILD_STACK_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if (child_stack == MAP_FAILED) { perror("mmap child stack"); exit(1); }
+    }
+    return child_stack;
+}
+
+static int clone_child_exit(void* arg) {
+    (void)arg;
+    place_child();
+    _exit(0);
+}
+
+static void act_clone_vm_vfork_exit_wait(void) {
+    pid_t p = clone(clone_child_exit, get_child_stack() + CHILD_STACK_SIZE,
+                    CLONE_VM | CLONE_VFORK | SIGCHLD, NULL);
+    if (p < 0) { perror("clone"); exit(1); }
+    int st;
+    if (waitpid(p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    sink_u64 ^= (uint64_t)st;
+}
+
+// 11, 12) clone3(). glibc has no wrapper, so the raw syscall is used with
+// the kernel's struct clone_args (the v0 layout, 64 bytes).
+#ifndef SYS_clone3
+  #define SYS_clone3 435
+#endif
+
+struct clone3_args {
+    uint64_t flags, pidfd, child_tid, parent_tid, exit_signal, stack, stack_size, tls;
+};
+
+// Without CLONE_VM the child resumes on a copy of our stack, so the plain
+// syscall() wrapper is safe: this is fork() by another entry point.
+static void act_clone3_child_exit_wait(void) {
+    struct clone3_args a = { .exit_signal = SIGCHLD };
+    long p = syscall(SYS_clone3, &a, sizeof a);
+    if (p < 0) { perror("clone3"); exit(1); }
+    if (p == 0) { place_child(); _exit(0); }
+    int st;
+    if (waitpid((pid_t)p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    sink_u64 ^= (uint64_t)st;
+}
+
+// With CLONE_VM the child starts on the new stack with no C frame to
+// return to, so it must not leave the asm: it exits right away. In place
+// of place_child() it makes the same sched_setaffinity call itself when
+// mask is set; r8 and r9 carry it across the clone3 syscall.
+#if defined(__x86_64__)
+  #define HAVE_CLONE3_VM 1
+static long clone3_exit_child(struct clone3_args* a, const cpu_set_t* mask) {
+    long ret;
+    register uint64_t mask_len __asm__("r8") = sizeof *mask;
+    register const cpu_set_t* mask_ptr __asm__("r9") = mask;
+    __asm__ volatile(
+        "syscall\n\t"
+        "test %%rax, %%rax\n\t"
+        "jnz 1f\n\t"
+        "test %%r9, %%r9\n\t"
+        "jz 2f\n\t"
+        "mov %[nr_affinity], %%eax\n\t"
+        "xor %%edi, %%edi\n\t"
+        "mov %%r8, %%rsi\n\t"
+        "mov %%r9, %%rdx\n\t"
+        "syscall\n\t"
+        "2:\n\t"
+        "mov %[nr_exit], %%eax\n\t"
+        "xor %%edi, %%edi\n\t"
+        "syscall\n\t"
+        "1:"
+        : "=a"(ret)
+        : "0"((long)SYS_clone3), "D"(a), "S"(sizeof *a), "r"(mask_len), "r"(mask_ptr),
+          [nr_exit] "i"(SYS_exit), [nr_affinity] "i"(SYS_sched_setaffinity)
+        : "rcx", "rdx", "r11", "memory");
+    return ret;
+}
+
+static void act_clone3_vm_vfork_exit_wait(void) {
+    struct clone3_args a = { .flags = CLONE_VM | CLONE_VFORK, .exit_signal = SIGCHLD,
+                             .stack = (uint64_t)(uintptr_t)get_child_stack(),
+                             .stack_size = CHILD_STACK_SIZE };
+    long p = clone3_exit_child(&a, child_mask());
+    if (p < 0) { errno = (int)-p; perror("clone3"); exit(1); }
+    int st;
+    if (waitpid((pid_t)p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    sink_u64 ^= (uint64_t)st;
+}
+#else
+  #define HAVE_CLONE3_VM 0
+#endif
+
+// 18-21) pidfds: the child comes with a pidfd (clone3 CLONE_PIDFD, or fork
+// then pidfd_open), exit is awaited by poll or epoll on it, and the child
+// is reaped with waitid(P_PIDFD). Compare with 6 and, for reaping, 5.
+#ifndef SYS_pidfd_open
+  #define SYS_pidfd_open 434
+#endif
+#ifndef P_PIDFD
+  #define P_PIDFD 3
+#endif
+
+static pid_t clone3_pidfd_child(int* pidfd) {
+    struct clone3_args a = { .flags = CLONE_PIDFD, .pidfd = (uint64_t)(uintptr_t)pidfd,
+                             .exit_signal = SIGCHLD };
+    long p = syscall(SYS_clone3, &a, sizeof a);
+    if (p < 0) { perror("clone3"); exit(1); }
+    if (p == 0) { place_child(); _exit(0); }
+    return (pid_t)p;
+}
+
+static void pidfd_reap(int pidfd) {
+    siginfo_t si;
+    if (waitid((idtype_t)P_PIDFD, (id_t)pidfd, &si, WEXITED) != 0) { perror("waitid"); exit(1); }
+    close(pidfd);
+    sink_u64 ^= (uint64_t)si.si_pid;
+}
+
+static void pidfd_poll(int pidfd) {
+    struct pollfd pfd = { .fd = pidfd, .events = POLLIN };
+    if (poll(&pfd, 1, -1) != 1) { perror("poll pidfd"); exit(1); }
+}
+
+static void act_clone3_pidfd_poll_waitid(void) {
+    int pidfd;
+    clone3_pidfd_child(&pidfd);
+    pidfd_poll(pidfd);
+    pidfd_reap(pidfd);
+}
+
+static void act_fork_pidfd_open_poll_waitid(void) {
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) { place_child(); _exit(0); }
+    int pidfd = (int)syscall(SYS_pidfd_open, p, 0);
+    if (pidfd < 0) { perror("pidfd_open"); exit(1); }
+    pidfd_poll(pidfd);
+    pidfd_reap(pidfd);
+}
+
+// a supervisor keeps one epoll set; so does each thread here
+static _Thread_local int pidfd_epoll = -1;
+static void act_clone3_pidfd_epoll_waitid(void) {
+    if (pidfd_epoll < 0 && (pidfd_epoll = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        perror("epoll_create1"); exit(1);
+    }
+    int pidfd;
+    clone3_pidfd_child(&pidfd);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = pidfd };
+    if (epoll_ctl(pidfd_epoll, EPOLL_CTL_ADD, pidfd, &ev) != 0) { perror("epoll_ctl"); exit(1); }
+    if (epoll_wait(pidfd_epoll, &ev, 1, -1) != 1) { perror("epoll_wait"); exit(1); }
+    // closing the pidfd in pidfd_reap() drops it from the set
+    pidfd_reap(pidfd);
+}
+
+// as 5, reaping an already-terminated child through its pidfd
+static _Thread_local int ready_pidfd = -1;
+static void setup_pidfd_ready(void) {
+    clone3_pidfd_child(&ready_pidfd);
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 2*1000*1000 }; // 2 ms
+    nanosleep(&ts, NULL);
+}
+static void act_waitid_pidfd_ready(void) {
+    siginfo_t si;
+    if (waitid((idtype_t)P_PIDFD, (id_t)ready_pidfd, &si, WEXITED) != 0) { perror("waitid"); exit(1); }
+    sink_u64 ^= (uint64_t)si.si_pid;
+}
+static void teardown_pidfd_ready(void) {
+    if (ready_pidfd >= 0) {
+        close(ready_pidfd);
+        ready_pidfd = -1;
+    }
+}
+
+// ---------- parent footprint ----------
+// Anonymous memory the parent maps and touches before the timed region, in
+// 4K pages or THP, optionally excluded from children by madvise.
+enum page_kind { PAGES_4K, PAGES_THP };
+static const char* const page_kind_names[] = { "4k", "thp" };
+enum fork_advice { ADVICE_NONE, ADVICE_DONTFORK, ADVICE_WIPEONFORK };
+static const char* const fork_advice_names[] = { "none", "dontfork", "wipeonfork" };
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+struct ballast {
+    char*  map;     // as mmap'd, with room to align for THP
+    size_t map_len;
+    char*  base;
+    size_t len;
+};
+
+static void ballast_map(struct ballast* b, size_t len, enum page_kind pages) {
+    b->len = len;
+    b->map_len = len + HUGE_PAGE_SIZE;
+    b->map = mmap(NULL, b->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->map == MAP_FAILED) { perror("mmap ballast"); exit(1); }
+    b->base = (char*)(((uintptr_t)b->map + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (madvise(b->base, len, pages == PAGES_THP ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) != 0)
+        fprintf(stderr, "note: madvise %s failed (%s)\n", page_kind_names[pages], strerror(errno));
+    for (size_t off = 0; off < len; off += 4096) b->base[off] = 1;
+}
+
+static void ballast_advise(const struct ballast* b, enum fork_advice advice) {
+    if (advice == ADVICE_NONE) return;
+    if (madvise(b->base, b->len, advice == ADVICE_DONTFORK ? MADV_DONTFORK : MADV_WIPEONFORK) != 0) {
+        fprintf(stderr, "madvise %s: %s\n", fork_advice_names[advice], strerror(errno));
+        exit(1);
+    }
+}
+
+static void ballast_unmap(struct ballast* b) {
+    munmap(b->map, b->map_len);
+    memset(b, 0, sizeof *b);
+}
+
+// Sizes like 512K, 16M, 4G.
+static size_t parse_size(const char* str) {
+    char* end;
+    double v = strtod(str, &end);
+    switch (*end) {
+        case 'k': case 'K': v *= 1024.0; break;
+        case 'm': case 'M': v *= 1024.0 * 1024.0; break;
+        case 'g': case 'G': v *= 1024.0 * 1024.0 * 1024.0; break;
+    }
+    return (size_t)v;
+}
+
+static void format_size(size_t bytes, char* buf, size_t len) {
+    if (bytes >= (1UL << 30) && bytes % (1UL << 30) == 0) snprintf(buf, len, "%zuG", bytes >> 30);
+    else if (bytes >= (1UL << 20) && bytes % (1UL << 20) == 0) snprintf(buf, len, "%zuM", bytes >> 20);
+    else snprintf(buf, len, "%zuK", bytes >> 10);
+}
+
+// A field of /proc/self/smaps_rollup or /proc/meminfo, in kB.
+static long read_kb(const char* path, const char* field) {
+    FILE* f = fopen(path, "r");
+    char line[256];
+    long kb = -1;
+    size_t n = strlen(field);
+    while (f && fgets(line, sizeof line, f))
+        if (strncmp(line, field, n) == 0 && line[n] == ':') { kb = strtol(line + n + 1, NULL, 10); break; }
+    if (f) fclose(f);
+    return kb;
+}
+
+// Index of name in names, or -1.
+static int name_index(const char* name, const char* const* names, int n) {
+    for (int i = 0; i < n; ++i)
+        if (strcmp(name, names[i]) == 0) return i;
+    return -1;
+}
+
+// 23) copy-on-write faults after fork: with the working set shared with a
+// paused child, either the parent writes one byte to each of K pages
+// (timed around the writes), or the child does and times itself. Pages are
+// of the backing size, 4K or 2M. Minor faults are counted per sample from
+// getrusage(), outside the timed writes.
+static struct {
+    struct ballast b;
+    size_t   stride;        // backing page size
+    size_t   pages;         // written per sample
+    pid_t    child;
+    int      go, done;      // our ends of the pipes to the child
+    long     minflt;        // at the end of setup
+    long     faults;
+    uint64_t samples;
+} cow;
+
+struct cow_result {
+    int64_t ticks;
+    long    faults;
+};
+
+static long minflt_self(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+static void cow_write(void) {
+    volatile char* p = cow.b.base;
+    for (size_t i = 0; i < cow.pages; ++i) p[i * cow.stride] ^= 1;
+}
+
+// The child holds the pages until our end of the go pipe closes, or with
+// child_writes, writes them when a byte arrives and reports back.
+static void cow_fork(bool child_writes) {
+    int go[2], done[2];
+    if (pipe(go) != 0 || pipe(done) != 0) { perror("pipe"); exit(1); }
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) {
+        place_child();
+        close(go[1]);
+        close(done[0]);
+        char c;
+        if (read(go[0], &c, 1) == 1 && child_writes) {
+            struct cow_result r;
+            long f0 = minflt_self();
+            uint64_t t0 = clock_begin();
+            cow_write();
+            uint64_t t1 = clock_end();
+            r.ticks = (int64_t)(t1 - t0);
+            r.faults = minflt_self() - f0;
+            if (write(done[1], &r, sizeof r) != (ssize_t)sizeof r) _exit(1);
+        }
+        _exit(0);
+    }
+    close(go[0]);
+    close(done[1]);
+    cow.child = p;
+    cow.go = go[1];
+    cow.done = done[0];
+}
+
+static void cow_reap(void) {
+    close(cow.go);
+    close(cow.done);
+    int st;
+    if (waitpid(cow.child, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    cow.samples++;
+}
+
+static void setup_cow_parent(void) {
+    cow_fork(false);
+    cow.minflt = minflt_self();
+}
+static void act_cow_parent_write(void) { cow_write(); }
+static void teardown_cow_parent(void) {
+    cow.faults += minflt_self() - cow.minflt;
+    cow_reap();
+}
+
+static void setup_cow_child(void) { cow_fork(true); }
+static void act_cow_child_write(void) {
+    struct cow_result r;
+    if (write(cow.go, "w", 1) != 1 || read(cow.done, &r, sizeof r) != (ssize_t)sizeof r) {
+        fprintf(stderr, "cow child did not report\n");
+        exit(1);
+    }
+    action_timed_itself(r.ticks);
+    cow.faults += r.faults;
+}
+
+// 24) fork as a snapshot (BGSAVE): the child serializes the heap, reading
+// every word in 64K chunks into a checksum, while the parent keeps doing 64-byte writes at random
+// offsets. Each write is one sample, before the fork and during the
+// snapshot window, which ends when the child reports it is done. Like
+// Redis, extra RSS is the child's Private_Dirty by then: the originals of
+// pages the parent has since copied.
+#define SNAP_CHUNK (64 * 1024)
+#define SNAP_POLL_EVERY 64
+
+static struct {
+    struct ballast b;
+    uint64_t rng;
+} snap = { .rng = 0x5EED };
+
+static void act_snapshot_write(void) {
+    uint64_t* p = (uint64_t*)(snap.b.base + rng_below(&snap.rng, snap.b.len / 64) * 64);
+    for (int i = 0; i < 8; ++i) p[i] += (uint64_t)i;
+}
+
+// A write() to /dev/null would not read the buffer, so the chunks are
+// summed into a volatile sink instead.
+static volatile uint64_t snap_sink;
+
+static void snapshot_child(int done_fd, int release_fd) {
+    place_child();
+    for (size_t off = 0; off < snap.b.len; off += SNAP_CHUNK) {
+        size_t n = snap.b.len - off < SNAP_CHUNK ? snap.b.len - off : SNAP_CHUNK;
+        const uint64_t* w = (const uint64_t*)(snap.b.base + off);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < n / sizeof *w; ++i) sum += w[i];
+        snap_sink += sum;
+    }
+    long private_kb = read_kb("/proc/self/smaps_rollup", "Private_Dirty");
+    if (write(done_fd, &private_kb, sizeof private_kb) != (ssize_t)sizeof private_kb) _exit(1);
+    char c;
+    while (read(release_fd, &c, 1) > 0) { }
+    _exit(0);
+}
+
+static bool fd_readable(int fd) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    return poll(&pfd, 1, 0) == 1;
+}
+
+// 7) system("/bin/true")
+static const char* TRUE_PATH = "/bin/true";
+static void act_system_true(void) {
+    int rc = system(TRUE_PATH);
+    if (rc == -1) { perror("system"); exit(1); }
+}
+
+// 13-16) spawning /bin/true without system(): posix_spawn, fork or vfork
+// followed by execve, and posix_spawn of the shell system() runs. Each
+// waits for the child. posix_spawn children cannot run place_child(), so
+// those take the child mask in setup like system().
+static const char* SH_PATH = "/bin/sh";
+extern char** environ;
+
+static void wait_child(pid_t p) {
+    int st;
+    if (waitpid(p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    if (!WIFEXITED(st) || WEXITSTATUS(st) != 0) { fprintf(stderr, "child failed\n"); exit(1); }
+    sink_u64 ^= (uint64_t)st;
+}
+
+static void spawn_wait(const char* path, char* const argv[]) {
+    pid_t p;
+    int rc = posix_spawn(&p, path, NULL, NULL, argv, environ);
+    if (rc != 0) { errno = rc; perror("posix_spawn"); exit(1); }
+    wait_child(p);
+}
+
+static void act_spawn_true(void) {
+    char* argv[] = { (char*)TRUE_PATH, NULL };
+    spawn_wait(TRUE_PATH, argv);
+}
+
+static void act_fork_exec_true(void) {
+    char* argv[] = { (char*)TRUE_PATH, NULL };
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) {
+        place_child();
+        execve(TRUE_PATH, argv, environ);
+        _exit(127);
+    }
+    wait_child(p);
+}
+
+static void act_vfork_exec_true(void) {
+    char* argv[] = { (char*)TRUE_PATH, NULL };
+    pid_t p = vfork();
+    if (p < 0) { perror("vfork"); exit(1); }
+    if (p == 0) {
+        place_child();
+        execve(TRUE_PATH, argv, environ);
+        _exit(127);
+    }
+    wait_child(p);
+}
+
+static void act_spawn_sh_true(void) {
+    char* argv[] = { "sh", "-c", (char*)TRUE_PATH, NULL };
+    spawn_wait(SH_PATH, argv);
+}
+
+// 25) exec cost matrix: fork + execve of the helpers the Makefile builds
+// under helpers/bin, timed to child exit or, through a stamp the helper's
+// main() writes to a shared memfd, to its first instruction in main.
+enum { STAMP_MAIN, STAMP_CHILD };   // slots: helper's main(), our forked child
+
+static _Thread_local struct {
+    char               dir[PATH_MAX];
+    char               path[PATH_MAX + 32];
+    char* const*       envp;
+    char               fd_env[32];
+    char*              plain_env[2];
+    char*              bind_now_env[3];
+    volatile uint64_t* stamp;
+    int                stamp_fd;
+} helper = { .stamp_fd = -1 };
+
+// Finds the helper directory and sets up the stamp memfd, once per thread.
+static void helper_init(void) {
+    if (helper.stamp_fd >= 0) return;
+    if (opt.helper_dir) {
+        snprintf(helper.dir, sizeof helper.dir, "%s", opt.helper_dir);
+    } else {
+        ssize_t n = readlink("/proc/self/exe", helper.dir, sizeof helper.dir - 1);
+        if (n < 0) { perror("readlink /proc/self/exe"); exit(1); }
+        helper.dir[n] = '\0';
+        char* slash = strrchr(helper.dir, '/');
+        if (slash) slash[1] = '\0';
+        else helper.dir[0] = '\0';
+        strncat(helper.dir, "helpers/bin", sizeof helper.dir - strlen(helper.dir) - 1);
+    }
+    helper.stamp_fd = memfd_create("gt_stamp", 0);   // inherited across exec
+    if (helper.stamp_fd < 0 || ftruncate(helper.stamp_fd, 4096) != 0) { perror("memfd"); exit(1); }
+    helper.stamp = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, helper.stamp_fd, 0);
+    if (helper.stamp == MAP_FAILED) { perror("mmap stamp"); exit(1); }
+    snprintf(helper.fd_env, sizeof helper.fd_env, "GT_STAMP_FD=%d", helper.stamp_fd);
+    helper.plain_env[0] = helper.fd_env;
+    helper.bind_now_env[0] = helper.fd_env;
+    helper.bind_now_env[1] = "LD_BIND_NOW=1";
+}
+
+// false if the helper was not built
+static bool helper_select(const char* file, bool bind_now) {
+    helper_init();
+    snprintf(helper.path, sizeof helper.path, "%s/%s", helper.dir, file);
+    helper.envp = bind_now ? helper.bind_now_env : helper.plain_env;
+    return access(helper.path, X_OK) == 0;
+}
+
+static pid_t fork_exec_helper(void) {
+    char* argv[] = { helper.path, NULL };
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) {
+        place_child();
+        execve(helper.path, argv, helper.envp);
+        _exit(127);
+    }
+    return p;
+}
+
+static void act_exec_helper_exit(void) { wait_child(fork_exec_helper()); }
+
+static void act_exec_helper_main(void) {
+    helper.stamp[STAMP_MAIN] = 0;
+    uint64_t t0 = nsecs_now();
+    wait_child(fork_exec_helper());
+    if (helper.stamp[STAMP_MAIN] < t0) { fprintf(stderr, "%s wrote no stamp\n", helper.path); exit(1); }
+    action_timed_itself((int64_t)((double)(helper.stamp[STAMP_MAIN] - t0) / clk.ns_per_tick));
+}
+
+// 26-28) child startup: the child's first timestamp after fork, taken
+// before place_child() so migration is not included, and the helper's
+// stamp at main() after execve, both through the stamp mapping. 27 and 28
+// exec the plain dynamic helper; the helper stamps CLOCK_MONOTONIC, so the
+// child does too before execve.
+static void act_fork_to_child_running(void) {
+    helper_init();
+    helper.stamp[STAMP_CHILD] = 0;
+    uint64_t t0 = clock_begin();
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) {
+        helper.stamp[STAMP_CHILD] = clock_end();
+        place_child();
+        _exit(0);
+    }
+    wait_child(p);
+    action_timed_itself((int64_t)(helper.stamp[STAMP_CHILD] - t0));
+}
+
+// once per thread; helper_init() alone (26) does not choose a helper
+static _Thread_local bool startup_helper_selected;
+static void select_startup_helper(void) {
+    if (startup_helper_selected) return;
+    if (!helper_select("exec_dyn0", false)) {
+        fprintf(stderr, "%s missing, run \"make helpers\"\n", helper.path);
+        exit(1);
+    }
+    startup_helper_selected = true;
+}
+
+// the child's stamp before execve, or the parent's before fork
+static uint64_t fork_exec_stamped(void) {
+    char* argv[] = { helper.path, NULL };
+    helper.stamp[STAMP_MAIN] = 0;
+    uint64_t t_fork = nsecs_now();
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) {
+        place_child();
+        helper.stamp[STAMP_CHILD] = nsecs_now();
+        execve(helper.path, argv, helper.envp);
+        _exit(127);
+    }
+    wait_child(p);
+    if (helper.stamp[STAMP_MAIN] == 0) { fprintf(stderr, "%s wrote no stamp\n", helper.path); exit(1); }
+    return t_fork;
+}
+
+static void act_execve_to_main(void) {
+    select_startup_helper();
+    fork_exec_stamped();
+    action_timed_itself((int64_t)((double)(helper.stamp[STAMP_MAIN] - helper.stamp[STAMP_CHILD]) /
+                                  clk.ns_per_tick));
+}
+
+static void act_fork_exec_to_main(void) {
+    select_startup_helper();
+    uint64_t t_fork = fork_exec_stamped();
+    action_timed_itself((int64_t)((double)(helper.stamp[STAMP_MAIN] - t_fork) / clk.ns_per_tick));
+}
+
+// 29-33) threads, to set against 4 and 6. New threads run place_child()
+// like forked children. glibc caches freed thread stacks, so after warm-up
+// creation reuses a stack rather than mapping one.
+static void* thread_noop(void* arg) {
+    place_child();
+    return arg;
+}
+
+static void check_pthread(int rc, const char* what) {
+    if (rc != 0) { errno = rc; perror(what); exit(1); }
+}
+
+// set by the stack sweep before any --scale workers start, and only read
+// by them; NULL for the default attributes
+static pthread_attr_t* thread_attr;
+
+static void act_thread_create_join(void) {
+    pthread_t t;
+    check_pthread(pthread_create(&t, thread_attr, thread_noop, NULL), "pthread_create");
+    check_pthread(pthread_join(t, NULL), "pthread_join");
+}
+
+// detached: timed to pthread_create() returning, like fork in 4; the
+// teardown waits until the thread has run, if the sample created one (the
+// overhead samples time an empty region with the same teardown)
+static _Thread_local atomic_int detached_ran;
+static _Thread_local bool detached_pending;
+static _Thread_local pthread_attr_t detached_attr;
+static _Thread_local bool detached_attr_ready;
+
+static void* thread_mark_ran(void* arg) {
+    place_child();
+    atomic_store_explicit((atomic_int*)arg, 1, memory_order_release);
+    return NULL;
+}
+
+static void act_thread_create_detached(void) {
+    if (!detached_attr_ready) {
+        pthread_attr_init(&detached_attr);
+        pthread_attr_setdetachstate(&detached_attr, PTHREAD_CREATE_DETACHED);
+        detached_attr_ready = true;
+    }
+    atomic_store(&detached_ran, 0);
+    detached_pending = true;
+    pthread_t t;
+    check_pthread(pthread_create(&t, &detached_attr, thread_mark_ran, &detached_ran),
+                  "pthread_create");
+}
+static void teardown_wait_detached(void) {
+    if (!detached_pending) return;
+    while (!atomic_load_explicit(&detached_ran, memory_order_acquire)) sched_yield();
+    detached_pending = false;
+}
+
+// Handoff to a pre-created worker: post a request, wait until the worker
+// has seen it. One worker per measuring thread, created on first use and
+// stopped by a thread-specific destructor when a --scale=threads worker
+// exits; otherwise it goes with the scenario's process.
+// shared: the word is in memory shared with another process
+static void futex_wait(atomic_uint* addr, unsigned val, bool shared) {
+    syscall(SYS_futex, addr, shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+static void futex_wake(atomic_uint* addr, bool shared) {
+    syscall(SYS_futex, addr, shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+struct handoff {
+    pthread_mutex_t mu;
+    pthread_cond_t  posted, served;
+    atomic_uint     req, done;
+    atomic_int      stop;
+    bool            futex;
+    pthread_t       worker;
+};
+
+static void* handoff_cond_worker(void* arg) {
+    struct handoff* h = arg;
+    place_child();
+    pthread_mutex_lock(&h->mu);
+    for (unsigned seen = 0;; ) {
+        while (atomic_load(&h->req) == seen) pthread_cond_wait(&h->posted, &h->mu);
+        if (atomic_load(&h->stop)) break;
+        seen = atomic_load(&h->req);
+        atomic_store(&h->done, seen);
+        pthread_cond_signal(&h->served);
+    }
+    pthread_mutex_unlock(&h->mu);
+    return NULL;
+}
+
+static void* handoff_futex_worker(void* arg) {
+    struct handoff* h = arg;
+    place_child();
+    for (unsigned seen = 0;; ) {
+        while (atomic_load(&h->req) == seen) futex_wait(&h->req, seen, false);
+        if (atomic_load(&h->stop)) break;
+        seen = atomic_load(&h->req);
+        atomic_store(&h->done, seen);
+        futex_wake(&h->done, false);
+    }
+    return NULL;
+}
+
+static void handoff_stop(void* arg) {
+    struct handoff* h = arg;
+    pthread_mutex_lock(&h->mu);
+    atomic_store(&h->stop, 1);
+    atomic_fetch_add(&h->req, 1);
+    pthread_cond_signal(&h->posted);
+    pthread_mutex_unlock(&h->mu);
+    if (h->futex) futex_wake(&h->req, false);
+    check_pthread(pthread_join(h->worker, NULL), "pthread_join");
+    pthread_cond_destroy(&h->served);
+    pthread_cond_destroy(&h->posted);
+    pthread_mutex_destroy(&h->mu);
+    free(h);
+}
+
+static pthread_key_t handoff_key[2];   // condvar, futex
+static pthread_once_t handoff_once = PTHREAD_ONCE_INIT;
+static void handoff_keys_init(void) {
+    for (int i = 0; i < 2; ++i)
+        check_pthread(pthread_key_create(&handoff_key[i], handoff_stop), "pthread_key_create");
+}
+
+static struct handoff* handoff_start(void* (*worker)(void*), bool futex) {
+    struct handoff* h = calloc(1, sizeof *h);
+    if (!h) { perror("calloc"); exit(1); }
+    pthread_mutex_init(&h->mu, NULL);
+    pthread_cond_init(&h->posted, NULL);
+    pthread_cond_init(&h->served, NULL);
+    h->futex = futex;
+    check_pthread(pthread_create(&h->worker, NULL, worker, h), "pthread_create");
+    pthread_once(&handoff_once, handoff_keys_init);
+    check_pthread(pthread_setspecific(handoff_key[futex], h), "pthread_setspecific");
+    return h;
+}
+
+static _Thread_local struct handoff* cond_handoff;
+static void act_handoff_cond(void) {
+    if (!cond_handoff) cond_handoff = handoff_start(handoff_cond_worker, false);
+    struct handoff* h = cond_handoff;
+    pthread_mutex_lock(&h->mu);
+    unsigned r = atomic_fetch_add(&h->req, 1) + 1;
+    pthread_cond_signal(&h->posted);
+    while (atomic_load(&h->done) != r) pthread_cond_wait(&h->served, &h->mu);
+    pthread_mutex_unlock(&h->mu);
+}
+
+static _Thread_local struct handoff* futex_handoff;
+static void act_handoff_futex(void) {
+    if (!futex_handoff) futex_handoff = handoff_start(handoff_futex_worker, true);
+    struct handoff* h = futex_handoff;
+    unsigned r = atomic_fetch_add(&h->req, 1) + 1;
+    futex_wake(&h->req, false);
+    for (unsigned d; (d = atomic_load(&h->done)) != r; ) futex_wait(&h->done, d, false);
+}
+
+// 34) ping-pong between the measuring thread and a peer process or thread.
+// Direction PING goes to the peer, PONG back. The shared block is mapped
+// MAP_SHARED so a forked peer sees the same futex words and semaphores.
+enum { PING, PONG };
+
+enum pp_kind { PP_PIPE, PP_EVENTFD, PP_FUTEX, PP_SEM, PP_SIGNAL, PP_KINDS };
+static const char* const pp_kind_names[] = { "pipe", "eventfd", "futex", "sem", "signal" };
+
+struct pingpong {
+    enum pp_kind kind;
+    bool         threads;      // peer is a thread, not a process
+    int          fd[2][2];     // per direction: pipe ends, or the eventfd twice
+    atomic_uint  word[2];
+    unsigned     seen[2];      // futex: posts consumed, touched by the waiter only
+    sem_t        sem[2];
+    pid_t        pid[2];
+    pthread_t    tid[2];
+    atomic_int   stop;
+    _Atomic uint64_t woke;     // peer's clock_end() when a ping arrived
+};
+
+static struct pingpong* pp;
+static const int pp_signo[2] = { SIGUSR1, SIGUSR2 };
+
+static void pp_post(int dir) {
+    switch (pp->kind) {
+        case PP_PIPE:
+            if (write(pp->fd[dir][1], "p", 1) != 1) { perror("write"); exit(1); }
+            break;
+        case PP_EVENTFD:
+            if (eventfd_write(pp->fd[dir][1], 1) != 0) { perror("eventfd_write"); exit(1); }
+            break;
+        case PP_FUTEX:
+            atomic_fetch_add(&pp->word[dir], 1);
+            futex_wake(&pp->word[dir], !pp->threads);
+            break;
+        case PP_SEM:
+            if (sem_post(&pp->sem[dir]) != 0) { perror("sem_post"); exit(1); }
+            break;
+        case PP_SIGNAL: {
+            union sigval v = { .sival_int = 0 };
+            int rc = pp->threads ? pthread_sigqueue(pp->tid[!dir], pp_signo[dir], v)
+                                 : (sigqueue(pp->pid[!dir], pp_signo[dir], v) ? errno : 0);
+            if (rc) { errno = rc; perror("sigqueue"); exit(1); }
+            break;
+        }
+        case PP_KINDS: break;
+    }
+}
+
+static void pp_wait(int dir) {
+    switch (pp->kind) {
+        case PP_PIPE: {
+            char c;
+            if (read(pp->fd[dir][0], &c, 1) != 1) { perror("read"); exit(1); }
+            break;
+        }
+        case PP_EVENTFD: {
+            eventfd_t v;
+            if (eventfd_read(pp->fd[dir][0], &v) != 0) { perror("eventfd_read"); exit(1); }
+            break;
+        }
+        case PP_FUTEX: {
+            unsigned seen = pp->seen[dir];
+            while (atomic_load(&pp->word[dir]) == seen) futex_wait(&pp->word[dir], seen, !pp->threads);
+            pp->seen[dir] = seen + 1;
+            break;
+        }
+        case PP_SEM:
+            while (sem_wait(&pp->sem[dir]) != 0)
+                if (errno != EINTR) { perror("sem_wait"); exit(1); }
+            break;
+        case PP_SIGNAL: {
+            sigset_t set;
+            sigemptyset(&set);
+            sigaddset(&set, pp_signo[dir]);
+            while (sigwaitinfo(&set, NULL) < 0)
+                if (errno != EINTR) { perror("sigwaitinfo"); exit(1); }
+            break;
+        }
+        case PP_KINDS: break;
+    }
+}
+
+static void* pp_peer(void* arg) {
+    (void)arg;
+    place_child();
+    for (;;) {
+        pp_wait(PING);
+        atomic_store(&pp->woke, clock_end());
+        if (atomic_load(&pp->stop)) break;
+        pp_post(PONG);
+    }
+    return NULL;
+}
+
+// Both signals stay blocked in the measuring thread while a peer runs;
+// peers inherit the mask.
+static void pp_start(enum pp_kind kind, bool threads, sigset_t* old_mask) {
+    pp = mmap(NULL, sizeof *pp, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (pp == MAP_FAILED) { perror("mmap"); exit(1); }
+    memset(pp, 0, sizeof *pp);
+    pp->kind = kind;
+    pp->threads = threads;
+    for (int d = 0; d < 2; ++d) {
+        if (kind == PP_PIPE && pipe(pp->fd[d]) != 0) { perror("pipe"); exit(1); }
+        if (kind == PP_EVENTFD) {
+            pp->fd[d][0] = pp->fd[d][1] = eventfd(0, 0);
+            if (pp->fd[d][0] < 0) { perror("eventfd"); exit(1); }
+        }
+        if (kind == PP_SEM && sem_init(&pp->sem[d], !threads, 0) != 0) { perror("sem_init"); exit(1); }
+    }
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigaddset(&set, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &set, old_mask);
+
+    pp->pid[0] = getpid();
+    pp->tid[0] = pthread_self();
+    if (threads) {
+        check_pthread(pthread_create(&pp->tid[1], NULL, pp_peer, NULL), "pthread_create");
+        return;
+    }
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) { pp_peer(NULL); _exit(0); }
+    pp->pid[1] = p;
+}
+
+static void pp_stop(const sigset_t* old_mask) {
+    atomic_store(&pp->stop, 1);
+    pp_post(PING);
+    if (pp->threads) check_pthread(pthread_join(pp->tid[1], NULL), "pthread_join");
+    else wait_child(pp->pid[1]);
+    for (int d = 0; d < 2; ++d) {
+        if (pp->kind == PP_PIPE) { close(pp->fd[d][0]); close(pp->fd[d][1]); }
+        if (pp->kind == PP_EVENTFD) close(pp->fd[d][0]);
+        if (pp->kind == PP_SEM) sem_destroy(&pp->sem[d]);
+    }
+    // drop a pong that was never waited for, e.g. after a failed run
+    sigset_t set;
+    sigpending(&set);
+    struct timespec zero = { 0, 0 };
+    for (int d = 0; d < 2; ++d)
+        if (sigismember(&set, pp_signo[d])) {
+            sigset_t one;
+            sigemptyset(&one);
+            sigaddset(&one, pp_signo[d]);
+            sigtimedwait(&one, NULL, &zero);
+        }
+    pthread_sigmask(SIG_SETMASK, old_mask, NULL);
+    munmap(pp, sizeof *pp);
+    pp = NULL;
+}
+
+// one-way: from before the post to the peer's wake-up
+static void act_pingpong_one_way(void) {
+    uint64_t t0 = clock_begin();
+    pp_post(PING);
+    pp_wait(PONG);
+    action_timed_itself(region_ticks(t0, atomic_load(&pp->woke)));
+}
+static void act_pingpong_round_trip(void) {
+    pp_post(PING);
+    pp_wait(PONG);
+}
+
+// 8) mkdir + rmdir
+static char dir_template[] = "/tmp/gtXXXXXX";
+static _Thread_local char workdir[PATH_MAX];
+static void setup_mkdir_rmdir(void) {
+    strcpy(workdir, dir_template);
+}
+static void act_mkdir_rmdir(void) {
+    char buf[PATH_MAX];
+    strcpy(buf, workdir);
+    if (!mkdtemp(buf)) { perror("mkdtemp"); exit(1); }
+    if (rmdir(buf) != 0) { perror("rmdir"); exit(1); }
+}
+
+// ========== scenario registry ==========
+struct scenario {
+    int         id;                // number accepted on the command line
+    const char* name;              // result label
+    uint64_t    iters;             // default sample count
+    action_fn   setup_each, action, teardown_each;
+    bool        subtract_overhead;
+    const char* tags;              // comma-separated groups for --tag
+    // Reports built from other scenarios run this instead of measure();
+    // iters is the --iters override, 0 for each scenario's default.
+    void      (*run)(const struct scenario* s, uint64_t iters);
+};
+
+static void run_system_decomposition(const struct scenario* s, uint64_t iters);
+static void run_fork_footprint_sweep(const struct scenario* s, uint64_t iters);
+static void run_cow_faults(const struct scenario* s, uint64_t iters);
+static void run_snapshot(const struct scenario* s, uint64_t iters);
+static void run_exec_matrix(const struct scenario* s, uint64_t iters);
+static void run_thread_stacks(const struct scenario* s, uint64_t iters);
+static void run_pingpong(const struct scenario* s, uint64_t iters);
+
+static const struct scenario scenarios[] = {
+    { 1, "scenario_1_empty_function_call", 200000,
+      NULL, act_call_empty, NULL, true, "cheap,call", NULL },
+    { 2, "scenario_2_drand48", 200000,
+      NULL, act_drand48, NULL, true, "cheap,libc", NULL },
+    { 3, "scenario_3_getppid", 200000,
+      NULL, act_getppid, NULL, true, "cheap,syscall", NULL },
+    { 4, "scenario_4_fork_parent_return", 8000,
+      NULL, act_fork_parent_return, teardown_wait_for_last_child, true, "process,fork", NULL },
+    // smaller default to avoid resource limits
+    { 5, "scenario_5_waitpid_already_terminated", 2000,
+      setup_waitpid_ready, act_waitpid_ready, teardown_wait_ready, true, "process,wait", NULL },
+    { 6, "scenario_6_fork_child_exit_waitpid", 4000,
+      NULL, act_fork_child_exit_wait, NULL, false, "process,fork,wait", NULL },
+    { 7, "scenario_7_system_true", 2500,
+      setup_child_mask, act_system_true, teardown_child_mask, false, "process,exec,shell", NULL },
+    { 8, "scenario_8_mkdir_rmdir", 20000,
+      setup_mkdir_rmdir, act_mkdir_rmdir, NULL, true, "fs", NULL },
+    { 9, "scenario_9_vfork_child_exit_waitpid", 4000,
+      NULL, act_vfork_child_exit_wait, NULL, false, "process,vfork,wait", NULL },
+    { 10, "scenario_10_clone_vm_vfork_child_exit_waitpid", 4000,
+      NULL, act_clone_vm_vfork_exit_wait, NULL, false, "process,vfork,clone,wait", NULL },
+#if HAVE_CLONE3_VM
+    { 11, "scenario_11_clone3_vm_vfork_child_exit_waitpid", 4000,
+      NULL, act_clone3_vm_vfork_exit_wait, NULL, false, "process,vfork,clone3,wait", NULL },
+#endif
+    { 12, "scenario_12_clone3_child_exit_waitpid", 4000,
+      NULL, act_clone3_child_exit_wait, NULL, false, "process,fork,clone3,wait", NULL },
+    { 13, "scenario_13_posix_spawn_true", 2500,
+      setup_child_mask, act_spawn_true, teardown_child_mask, false, "process,exec,spawn", NULL },
+    { 14, "scenario_14_fork_execve_true", 2500,
+      NULL, act_fork_exec_true, NULL, false, "process,exec,fork", NULL },
+    { 15, "scenario_15_vfork_execve_true", 2500,
+      NULL, act_vfork_exec_true, NULL, false, "process,exec,vfork", NULL },
+    { 16, "scenario_16_posix_spawn_sh_c_true", 2500,
+      setup_child_mask, act_spawn_sh_true, teardown_child_mask, false,
+      "process,exec,spawn,shell", NULL },
+    { 17, "scenario_17_system_decomposition", 0,
+      NULL, NULL, NULL, false, "process,exec,shell,report", run_system_decomposition },
+    { 18, "scenario_18_clone3_pidfd_poll_waitid", 4000,
+      NULL, act_clone3_pidfd_poll_waitid, NULL, false, "process,clone3,pidfd,wait", NULL },
+    { 19, "scenario_19_fork_pidfd_open_poll_waitid", 4000,
+      NULL, act_fork_pidfd_open_poll_waitid, NULL, false, "process,fork,pidfd,wait", NULL },
+    { 20, "scenario_20_clone3_pidfd_epoll_waitid", 4000,
+      NULL, act_clone3_pidfd_epoll_waitid, NULL, false, "process,clone3,pidfd,wait", NULL },
+    { 21, "scenario_21_waitid_pidfd_already_terminated", 2000,
+      setup_pidfd_ready, act_waitid_pidfd_ready, teardown_pidfd_ready, true, "process,pidfd,wait", NULL },
+    { 22, "scenario_22_fork_footprint_sweep", 200,
+      NULL, NULL, NULL, false, "process,fork,vfork,memory,report", run_fork_footprint_sweep },
+    { 23, "scenario_23_cow_fault_cost", 500,
+      NULL, NULL, NULL, false, "process,fork,memory,report", run_cow_faults },
+    { 24, "scenario_24_snapshot_write_latency", 20000,
+      NULL, NULL, NULL, false, "process,fork,memory,report", run_snapshot },
+    { 25, "scenario_25_exec_matrix", 1000,
+      NULL, NULL, NULL, false, "process,exec,fork,report", run_exec_matrix },
+    { 26, "scenario_26_fork_to_child_running", 4000,
+      NULL, act_fork_to_child_running, NULL, false, "process,fork,startup", NULL },
+    { 27, "scenario_27_execve_to_main", 2000,
+      NULL, act_execve_to_main, NULL, false, "process,exec,startup", NULL },
+    { 28, "scenario_28_fork_execve_to_main", 2000,
+      NULL, act_fork_exec_to_main, NULL, false, "process,fork,exec,startup", NULL },
+    { 29, "scenario_29_pthread_create_join", 20000,
+      NULL, act_thread_create_join, NULL, false, "thread,create", NULL },
+    { 30, "scenario_30_pthread_create_detached", 20000,
+      NULL, act_thread_create_detached, teardown_wait_detached, true, "thread,create", NULL },
+    { 31, "scenario_31_thread_handoff_condvar", 50000,
+      NULL, act_handoff_cond, NULL, true, "thread,handoff", NULL },
+    { 32, "scenario_32_thread_handoff_futex", 50000,
+      NULL, act_handoff_futex, NULL, true, "thread,handoff", NULL },
+    { 33, "scenario_33_pthread_stack_sweep", 5000,
+      NULL, NULL, NULL, false, "thread,create,report", run_thread_stacks },
+    { 34, "scenario_34_pingpong", 10000,
+      NULL, NULL, NULL, false, "ipc,wakeup,report", run_pingpong },
+};
+#define NSCENARIOS (sizeof scenarios / sizeof scenarios[0])
+
+static bool has_tag(const char* tags, const char* tag) {
+    size_t n = strlen(tag);
+    for (const char* p = tags; *p; ) {
+        size_t len = strcspn(p, ",");
+        if (len == n && strncmp(p, tag, n) == 0) return true;
+        p += len + (p[len] == ',');
+    }
+    return false;
+}
+
+// A number, a name, or a glob over names ("*fork*").
+static bool scenario_matches(const struct scenario* s, const char* pat) {
+    char* end;
+    long id = strtol(pat, &end, 10);
+    if (*pat && *end == '\0') return id == s->id;
+    return fnmatch(pat, s->name, 0) == 0;
+}
+
+static const struct scenario* find_scenario(int id) {
+    for (size_t i = 0; i < NSCENARIOS; ++i)
+        if (scenarios[i].id == id) return &scenarios[i];
+    return NULL;
+}
+
+// system() in glibc spawns "sh -c" with CLONE_VM|CLONE_VFORK, blocks
+// SIGCHLD, ignores SIGINT and SIGQUIT, and waits. Its median is split by
+// differences of scenario medians, which add up to it:
+//   wait              waitpid on a terminated child (5)
+//   process_creation  clone(CLONE_VM|CLONE_VFORK) + _exit, less wait (10 - 5)
+//   inner_exec        execve of true with loader and run (13 - 10)
+//   shell             exec and startup of sh -c (16 - 13)
+//   system_extra      signal handling inside system() (7 - 16)
+// fork_instead_of_spawn (14 - 13) is what classic fork adds, for reference.
+// The medians come from independent runs, so each component gets a 95% CI
+// from the medians' CIs, their half-widths added in quadrature. Components
+// whose CI includes 0 are listed as unresolved, those below 0 as negative
+// (drift between the runs). Shares are given only when no component of
+// system() is either, so that they add up to 1.
+static void run_system_decomposition(const struct scenario* s, uint64_t iters) {
+    static const int ids[] = { 5, 10, 13, 16, 7, 14 };
+    struct stats st[17] = { { 0 } };
+    for (size_t i = 0; i < sizeof ids / sizeof ids[0]; ++i) {
+        const struct scenario* c = find_scenario(ids[i]);
+        st[ids[i]] = measure(c->name, c->setup_each, c->action, c->teardown_each,
+                             iters ? iters : c->iters, c->subtract_overhead);
+    }
+    if (opt.scale != SCALE_NONE) {
+        fprintf(stderr, "note: %s has no scaling mode\n", s->name);
+        return;
+    }
+    bool have_ci = true;
+    for (size_t i = 0; i < sizeof ids / sizeof ids[0]; ++i)
+        have_ci &= st[ids[i]].ci_method != NULL;
+
+    struct { const char* name; int plus, minus; } parts[] = {
+        { "wait",                  5,  0 },
+        { "process_creation",      10, 5 },
+        { "inner_exec",            13, 10 },
+        { "shell",                 16, 13 },
+        { "system_extra",          7,  16 },
+        { "fork_instead_of_spawn", 14, 13 },
+    };
+    enum { NPARTS = sizeof parts / sizeof parts[0], NSHARES = NPARTS - 1 };
+    out_begin(s->name);
+    out_str("method", "%s", "differences of scenario medians (5 10 13 16 7)");
+    out_str("ci_method", "%s", have_ci ? "median CIs combined in quadrature"
+                                       : "none (median CIs unavailable)");
+    out_stat("p50", "system", st[7].p50);
+    char unresolved[256] = "", negative[256] = "";
+    bool shares_ok = true;
+    for (int i = 0; i < NPARTS; ++i) {
+        const struct stats* a = &st[parts[i].plus];
+        const struct stats* b = parts[i].minus ? &st[parts[i].minus] : NULL;
+        double v = a->p50 - (b ? b->p50 : 0.0);
+        out_stat(parts[i].name, "p50", v);
+
+        double lo = v, hi = v;
+        if (have_ci) {
+            double ha = (a->median_hi - a->median_lo) / 2.0;
+            double hb = b ? (b->median_hi - b->median_lo) / 2.0 : 0.0;
+            double h = sqrt(ha * ha + hb * hb);
+            lo = v - h;
+            hi = v + h;
+            char key[64];
+            snprintf(key, sizeof key, "%s_ci95_lo", parts[i].name);
+            out_stat(key, "p50", lo);
+            snprintf(key, sizeof key, "%s_ci95_hi", parts[i].name);
+            out_stat(key, "p50", hi);
+        }
+        char* list = hi < 0.0 ? negative : lo <= 0.0 ? unresolved : NULL;
+        if (list) {
+            size_t used = strlen(list);
+            snprintf(list + used, sizeof unresolved - used, "%s%s", used ? " " : "", parts[i].name);
+            if (i < NSHARES) shares_ok = false;
+        }
+    }
+    out_str("unresolved", "%s", unresolved[0] ? unresolved : "none");
+    out_str("negative", "%s", negative[0] ? negative : "none");
+    if (!shares_ok) {
+        out_str("shares", "%s", "omitted (a component is unresolved or negative)");
+    } else {
+        for (int i = 0; i < NSHARES; ++i) {
+            char key[64];
+            snprintf(key, sizeof key, "%s_share", parts[i].name);
+            out_num(key, "%.3f", (st[parts[i].plus].p50 -
+                                  (parts[i].minus ? st[parts[i].minus].p50 : 0.0)) / st[7].p50);
+        }
+    }
+    out_end();
+}
+
+// Scenarios 4, 6 and 9 from a parent holding each --footprint size, for
+// each page kind and fork advice. Sizes beyond MemAvailable are skipped.
+// The summary has one row per point; structured formats get its cells as
+// keys prefixed by the point, e.g. 256M_thp_none_fork_return_p50.
+static void run_fork_footprint_sweep(const struct scenario* s, uint64_t iters) {
+    static const int ids[] = { 4, 6, 9 };
+    static const char* const cols[] = { "fork_return", "fork_exit_wait", "vfork_exit_wait" };
+    struct point {
+        char   name[64];
+        double rss_mb, thp_mb;
+        double p50[3], p99[3];
+    };
+    struct point* pts = NULL;
+    size_t npts = 0;
+    long avail_kb = read_kb("/proc/meminfo", "MemAvailable");
+
+    char sizes[256];
+    snprintf(sizes, sizeof sizes, "%s", opt.footprints);
+    for (char* sv = NULL, *sz = strtok_r(sizes, ",", &sv); sz; sz = strtok_r(NULL, ",", &sv)) {
+        size_t len = parse_size(sz);
+        char size_name[32];
+        format_size(len, size_name, sizeof size_name);
+        if (avail_kb > 0 && len / 1024 > (size_t)avail_kb * 3 / 4) {
+            fprintf(stderr, "note: skipping %s, MemAvailable is %ld kB\n", size_name, avail_kb);
+            continue;
+        }
+        char pages[64];
+        snprintf(pages, sizeof pages, "%s", opt.fp_pages);
+        for (char* pv = NULL, *pg = strtok_r(pages, ",", &pv); pg; pg = strtok_r(NULL, ",", &pv)) {
+            int kind = name_index(pg, page_kind_names, 2);
+            if (kind < 0) { fprintf(stderr, "unknown page kind %s\n", pg); exit(2); }
+            char advices[64];
+            snprintf(advices, sizeof advices, "%s", opt.fp_advice);
+            for (char* av = NULL, *ad = strtok_r(advices, ",", &av); ad; ad = strtok_r(NULL, ",", &av)) {
+                int advice = name_index(ad, fork_advice_names, 3);
+                if (advice < 0) { fprintf(stderr, "unknown fork advice %s\n", ad); exit(2); }
+
+                struct ballast b;
+                ballast_map(&b, len, (enum page_kind)kind);
+                ballast_advise(&b, (enum fork_advice)advice);
+                pts = realloc(pts, (npts + 1) * sizeof *pts);
+                if (!pts) { perror("realloc"); exit(1); }
+                struct point* pt = &pts[npts++];
+                snprintf(pt->name, sizeof pt->name, "%s_%s_%s", size_name, pg, ad);
+                pt->rss_mb = read_kb("/proc/self/smaps_rollup", "Rss") / 1024.0;
+                pt->thp_mb = read_kb("/proc/self/smaps_rollup", "AnonHugePages") / 1024.0;
+                for (int c = 0; c < 3; ++c) {
+                    const struct scenario* sc = find_scenario(ids[c]);
+                    char label[160];
+                    snprintf(label, sizeof label, "%s_%s_%s", s->name, pt->name, cols[c]);
+                    struct stats st = measure(label, sc->setup_each, sc->action, sc->teardown_each,
+                                              iters ? iters : s->iters, sc->subtract_overhead);
+                    pt->p50[c] = st.p50;
+                    pt->p99[c] = st.p99;
+                }
+                ballast_unmap(&b);
+            }
+        }
+    }
+    if (opt.scale != SCALE_NONE) fprintf(stderr, "note: %s has no scaling summary\n", s->name);
+    if (opt.scale != SCALE_NONE || npts == 0) { free(pts); return; }
+
+    char name[300];
+    snprintf(name, sizeof name, "%s_summary", s->name);
+    out_begin(name);
+    if (out.fmt == FORMAT_TEXT) {
+        printf("point,rss_mb,thp_mb");
+        for (int c = 0; c < 3; ++c) printf(",%s_p50_%s,%s_p99_%s", cols[c], report.unit, cols[c], report.unit);
+        printf("\n");
+    }
+    for (size_t i = 0; i < npts; ++i) {
+        const struct point* pt = &pts[i];
+        if (out.fmt == FORMAT_TEXT) {
+            printf("%s,%.1f,%.1f", pt->name, pt->rss_mb, pt->thp_mb);
+            for (int c = 0; c < 3; ++c)
+                printf(",%.3f,%.3f", pt->p50[c] * report.per_tick, pt->p99[c] * report.per_tick);
+            printf("\n");
+            continue;
+        }
+        char key[128];
+        snprintf(key, sizeof key, "%s_rss_mb", pt->name);
+        out_num(key, "%.1f", pt->rss_mb);
+        snprintf(key, sizeof key, "%s_thp_mb", pt->name);
+        out_num(key, "%.1f", pt->thp_mb);
+        for (int c = 0; c < 3; ++c) {
+            snprintf(key, sizeof key, "%s_%s_p50", pt->name, cols[c]);
+            out_stat(key, "total", pt->p50[c]);
+            snprintf(key, sizeof key, "%s_%s_p99", pt->name, cols[c]);
+            out_stat(key, "total", pt->p99[c]);
+        }
+    }
+    out_end();
+    free(pts);
+}
+
+// Scenario 23 for each --footprint-pages kind, with the parent and then
+// the child writing. The summary divides by the pages written.
+static void run_cow_faults(const struct scenario* s, uint64_t iters) {
+    if (opt.scale != SCALE_NONE) {
+        fprintf(stderr, "note: %s has no scaling mode\n", s->name);
+        return;
+    }
+    static const char* const writers[] = { "parent", "child" };
+    struct cow_row {
+        char        name[32];
+        size_t      page_kb, pages;
+        double      faults;
+        struct stats st;
+    } rows[4];
+    int nrows = 0;
+
+    char pages[64];
+    snprintf(pages, sizeof pages, "%s", opt.fp_pages);
+    for (char* pv = NULL, *pg = strtok_r(pages, ",", &pv); pg && nrows < 4; pg = strtok_r(NULL, ",", &pv)) {
+        int kind = name_index(pg, page_kind_names, 2);
+        if (kind < 0) { fprintf(stderr, "unknown page kind %s\n", pg); exit(2); }
+        ballast_map(&cow.b, opt.cow_size, (enum page_kind)kind);
+        cow.stride = kind == PAGES_THP ? HUGE_PAGE_SIZE : 4096;
+        cow.pages = opt.cow_pages < opt.cow_size / cow.stride ? opt.cow_pages : opt.cow_size / cow.stride;
+        for (int wr = 0; wr < 2; ++wr) {
+            struct cow_row* r = &rows[nrows++];
+            snprintf(r->name, sizeof r->name, "%s_%s", pg, writers[wr]);
+            char label[160];
+            snprintf(label, sizeof label, "%s_%.*s", s->name, (int)sizeof r->name, r->name);
+            cow.faults = 0;
+            cow.samples = 0;
+            r->st = wr == 0
+                ? measure(label, setup_cow_parent, act_cow_parent_write, teardown_cow_parent,
+                          iters ? iters : s->iters, false)
+                : measure(label, setup_cow_child, act_cow_child_write, cow_reap,
+                          iters ? iters : s->iters, false);
+            r->page_kb = cow.stride / 1024;
+            r->pages = cow.pages;
+            r->faults = cow.samples ? (double)cow.faults / (double)cow.samples : 0.0;
+        }
+        ballast_unmap(&cow.b);
+    }
+
+    char name[300];
+    char size_name[32];
+    format_size(opt.cow_size, size_name, sizeof size_name);
+    snprintf(name, sizeof name, "%s_summary", s->name);
+    out_begin(name);
+    out_str("working_set", "%s", size_name);
+    if (out.fmt == FORMAT_TEXT)
+        printf("point,page_kb,pages_written,faults_per_sample,p50_%s,per_page_p50_%s,per_page_p99_%s\n",
+               report.unit, report.unit, report.unit);
+    for (int i = 0; i < nrows; ++i) {
+        const struct cow_row* r = &rows[i];
+        double k = (double)r->pages;
+        if (out.fmt == FORMAT_TEXT) {
+            printf("%s,%zu,%zu,%.1f,%.3f,%.3f,%.3f\n", r->name, r->page_kb, r->pages, r->faults,
+                   r->st.p50 * report.per_tick, r->st.p50 / k * report.per_tick,
+                   r->st.p99 / k * report.per_tick);
+            continue;
+        }
+        char key[128];
+        snprintf(key, sizeof key, "%.*s_page_kb", (int)sizeof r->name, r->name);
+        out_num(key, "%zu", r->page_kb);
+        snprintf(key, sizeof key, "%.*s_pages_written", (int)sizeof r->name, r->name);
+        out_num(key, "%zu", r->pages);
+        snprintf(key, sizeof key, "%.*s_faults_per_sample", (int)sizeof r->name, r->name);
+        out_num(key, "%.1f", r->faults);
+        snprintf(key, sizeof key, "%.*s_per_page_p50", (int)sizeof r->name, r->name);
+        out_stat(key, "total", r->st.p50 / k);
+        snprintf(key, sizeof key, "%.*s_per_page_p99", (int)sizeof r->name, r->name);
+        out_stat(key, "total", r->st.p99 / k);
+    }
+    out_end();
+}
+
+// Scenario 24 for each --footprint-pages kind: measure() gives the write
+// latency before the fork; the snapshot window is sampled with the same
+// take_samples() loop until the child is done.
+static void run_snapshot(const struct scenario* s, uint64_t iters) {
+    if (opt.scale != SCALE_NONE) {
+        fprintf(stderr, "note: %s has no scaling mode\n", s->name);
+        return;
+    }
+    char pages[64];
+    snprintf(pages, sizeof pages, "%s", opt.fp_pages);
+    for (char* pv = NULL, *pg = strtok_r(pages, ",", &pv); pg; pg = strtok_r(NULL, ",", &pv)) {
+        int kind = name_index(pg, page_kind_names, 2);
+        if (kind < 0) { fprintf(stderr, "unknown page kind %s\n", pg); exit(2); }
+        ballast_map(&snap.b, opt.snap_size, (enum page_kind)kind);
+
+        char label[160];
+        snprintf(label, sizeof label, "%s_%s_before", s->name, pg);
+        struct stats before = measure(label, NULL, act_snapshot_write, NULL,
+                                      iters ? iters : s->iters, false);
+
+        int done[2], release[2];
+        if (pipe(done) != 0 || pipe(release) != 0) { perror("pipe"); exit(1); }
+        long flt0 = minflt_self();
+        uint64_t t_fork = nsecs_now();
+        pid_t p = fork();
+        if (p < 0) { perror("fork"); exit(1); }
+        if (p == 0) {
+            close(done[0]);
+            close(release[1]);
+            snapshot_child(done[1], release[0]);
+        }
+        uint64_t t_forked = nsecs_now();
+        close(done[1]);
+        close(release[0]);
+
+        struct workload w = { NULL, act_snapshot_write, NULL, 1, NULL };
+        struct sampler during;
+        sampler_init(&during, opt.hist);
+        sampler_reserve(&during, 1 << 16);
+        while (!fd_readable(done[0])) {
+            if (!during.h && during.n + SNAP_POLL_EVERY > during.cap)
+                sampler_reserve(&during, during.cap * 2);
+            take_samples(&w, &during, SNAP_POLL_EVERY);
+        }
+        uint64_t t_done = nsecs_now();
+        long faults = minflt_self() - flt0;
+        long private_kb = -1;
+        if (read(done[0], &private_kb, sizeof private_kb) != (ssize_t)sizeof private_kb)
+            private_kb = -1;
+        close(release[1]);
+        close(done[0]);
+        int st;
+        if (waitpid(p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+
+        struct stats st_during;
+        sampler_stats(&during, &st_during);
+        if (!during.h) bootstrap_ci(during.v, during.n, opt.bootstrap, &st_during);
+        snprintf(label, sizeof label, "%s_%s_during", s->name, pg);
+        out_begin(label);
+        out_num("iters", "%" PRIu64, during.n);
+        out_str("clock", "%s", clk.kind == CLOCK_KIND_TSC ? "tsc" : "monotonic");
+        print_placement();
+        print_env();
+        out_num("heap_mb", "%.1f", (double)snap.b.len / (1 << 20));
+        out_num("fork_ns", "%" PRIu64, t_forked - t_fork);
+        out_num("snapshot_ns", "%" PRIu64, t_done - t_fork);
+        out_num("parent_faults", "%ld", faults);
+        if (private_kb >= 0) out_num("extra_rss_mb", "%.1f", private_kb / 1024.0);
+        print_stats("total", &st_during);
+        print_stats_method(&st_during, opt.bootstrap);
+        out_end();
+
+        snprintf(label, sizeof label, "%s_%s_summary", s->name, pg);
+        out_begin(label);
+        struct { const char* name; double before, during; } q[] = {
+            { "p50", before.p50, st_during.p50 }, { "p99", before.p99, st_during.p99 },
+            { "p999", before.p999, st_during.p999 }, { "max", before.max, st_during.max },
+        };
+        for (size_t i = 0; i < sizeof q / sizeof q[0]; ++i) {
+            char key[64];
+            out_stat(q[i].name, "before", q[i].before);
+            out_stat(q[i].name, "during", q[i].during);
+            snprintf(key, sizeof key, "%s_ratio", q[i].name);
+            out_num(key, "%.2f", q[i].before > 0 ? q[i].during / q[i].before : 0.0);
+        }
+        out_end();
+
+        sampler_free(&during);
+        ballast_unmap(&snap.b);
+    }
+}
+
+// Each helper is measured twice, to exit and to main; the difference is
+// roughly what runs after main plus exit and reaping. Helpers missing from
+// the directory (not built with "make helpers") are skipped.
+static void run_exec_matrix(const struct scenario* s, uint64_t iters) {
+    if (opt.scale != SCALE_NONE) {
+        fprintf(stderr, "note: %s has no scaling mode\n", s->name);
+        return;
+    }
+    static const struct {
+        const char* name;
+        const char* file;
+        bool        bind_now;
+    } rows_def[] = {
+        { "static",       "exec_static",  false },
+        { "dyn0",         "exec_dyn0",    false },
+        { "dyn10",        "exec_dyn10",   false },
+        { "dyn50",        "exec_dyn50",   false },
+        { "dyn50_bind_now", "exec_dyn50", true },
+        { "bigtext",      "exec_bigtext", false },
+    };
+    enum { NROWS = sizeof rows_def / sizeof rows_def[0] };
+    struct { struct stats to_main, to_exit; bool ran; } rows[NROWS] = { 0 };
+
+    for (int i = 0; i < NROWS; ++i) {
+        if (!helper_select(rows_def[i].file, rows_def[i].bind_now)) {
+            fprintf(stderr, "note: %s missing, run \"make helpers\"\n", helper.path);
+            continue;
+        }
+        char label[160];
+        snprintf(label, sizeof label, "%s_%s_to_main", s->name, rows_def[i].name);
+        rows[i].to_main = measure(label, NULL, act_exec_helper_main, NULL,
+                                  iters ? iters : s->iters, false);
+        snprintf(label, sizeof label, "%s_%s_to_exit", s->name, rows_def[i].name);
+        rows[i].to_exit = measure(label, NULL, act_exec_helper_exit, NULL,
+                                  iters ? iters : s->iters, false);
+        rows[i].ran = true;
+    }
+
+    char name[300];
+    snprintf(name, sizeof name, "%s_summary", s->name);
+    out_begin(name);
+    if (out.fmt == FORMAT_TEXT)
+        printf("helper,to_main_p50_%s,to_main_p99_%s,to_exit_p50_%s,to_exit_p99_%s\n",
+               report.unit, report.unit, report.unit, report.unit);
+    for (int i = 0; i < NROWS; ++i) {
+        if (!rows[i].ran) continue;
+        if (out.fmt == FORMAT_TEXT) {
+            printf("%s,%.3f,%.3f,%.3f,%.3f\n", rows_def[i].name,
+                   rows[i].to_main.p50 * report.per_tick, rows[i].to_main.p99 * report.per_tick,
+                   rows[i].to_exit.p50 * report.per_tick, rows[i].to_exit.p99 * report.per_tick);
+            continue;
+        }
+        char key[64];
+        snprintf(key, sizeof key, "%s_to_main_p50", rows_def[i].name);
+        out_stat(key, "total", rows[i].to_main.p50);
+        snprintf(key, sizeof key, "%s_to_main_p99", rows_def[i].name);
+        out_stat(key, "total", rows[i].to_main.p99);
+        snprintf(key, sizeof key, "%s_to_exit_p50", rows_def[i].name);
+        out_stat(key, "total", rows[i].to_exit.p50);
+        snprintf(key, sizeof key, "%s_to_exit_p99", rows_def[i].name);
+        out_stat(key, "total", rows[i].to_exit.p99);
+    }
+    out_end();
+}
+
+// Scenario 29 with each --thread-stacks size and --thread-guards guard.
+// Sizes below the system minimum, and stacks with no room left for the
+// guard and static TLS, are skipped.
+static void run_thread_stacks(const struct scenario* s, uint64_t iters) {
+    struct point {
+        char   name[80];
+        struct stats st;
+    };
+    struct point* pts = NULL;
+    size_t npts = 0;
+    long min_stack = sysconf(_SC_THREAD_STACK_MIN);
+
+    char stacks[256];
+    snprintf(stacks, sizeof stacks, "%s", opt.stacks);
+    for (char* sv = NULL, *sz = strtok_r(stacks, ",", &sv); sz; sz = strtok_r(NULL, ",", &sv)) {
+        size_t stack = parse_size(sz);
+        char stack_name[32];
+        format_size(stack, stack_name, sizeof stack_name);
+        if (min_stack > 0 && stack < (size_t)min_stack) {
+            fprintf(stderr, "note: skipping stack %s, below the minimum %ld\n", stack_name, min_stack);
+            continue;
+        }
+        char guards[256];
+        snprintf(guards, sizeof guards, "%s", opt.guards);
+        for (char* gv = NULL, *gd = strtok_r(guards, ",", &gv); gd; gd = strtok_r(NULL, ",", &gv)) {
+            size_t guard = parse_size(gd);
+            char guard_name[32];
+            format_size(guard, guard_name, sizeof guard_name);
+            if (guard >= stack) {
+                fprintf(stderr, "note: skipping stack %s with guard %s, no room left\n",
+                        stack_name, guard_name);
+                continue;
+            }
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            check_pthread(pthread_attr_setstacksize(&attr, stack), "pthread_attr_setstacksize");
+            check_pthread(pthread_attr_setguardsize(&attr, guard), "pthread_attr_setguardsize");
+            // the stack must also hold static TLS, which the minimum ignores
+            pthread_t probe;
+            int rc = pthread_create(&probe, &attr, thread_noop, NULL);
+            if (rc == EINVAL) {
+                fprintf(stderr, "note: skipping stack %s with guard %s, too small for this binary\n",
+                        stack_name, guard_name);
+                pthread_attr_destroy(&attr);
+                continue;
+            }
+            check_pthread(rc, "pthread_create");
+            check_pthread(pthread_join(probe, NULL), "pthread_join");
+            thread_attr = &attr;
+
+            pts = realloc(pts, (npts + 1) * sizeof *pts);
+            if (!pts) { perror("realloc"); exit(1); }
+            struct point* pt = &pts[npts++];
+            snprintf(pt->name, sizeof pt->name, "stack%s_guard%s", stack_name, guard_name);
+            char label[160];
+            snprintf(label, sizeof label, "%s_%s", s->name, pt->name);
+            pt->st = measure(label, NULL, act_thread_create_join, NULL,
+                             iters ? iters : s->iters, false);
+
+            thread_attr = NULL;
+            pthread_attr_destroy(&attr);
+        }
+    }
+    if (opt.scale != SCALE_NONE) fprintf(stderr, "note: %s has no scaling summary\n", s->name);
+    if (opt.scale != SCALE_NONE || npts == 0) { free(pts); return; }
+
+    char name[300];
+    snprintf(name, sizeof name, "%s_summary", s->name);
+    out_begin(name);
+    if (out.fmt == FORMAT_TEXT) printf("point,p50_%s,p99_%s\n", report.unit, report.unit);
+    for (size_t i = 0; i < npts; ++i) {
+        if (out.fmt == FORMAT_TEXT) {
+            printf("%s,%.3f,%.3f\n", pts[i].name, pts[i].st.p50 * report.per_tick,
+                   pts[i].st.p99 * report.per_tick);
+            continue;
+        }
+        char key[128];
+        snprintf(key, sizeof key, "%s_p50", pts[i].name);
+        out_stat(key, "total", pts[i].st.p50);
+        snprintf(key, sizeof key, "%s_p99", pts[i].name);
+        out_stat(key, "total", pts[i].st.p99);
+    }
+    out_end();
+    free(pts);
+}
+
+// Every primitive against a peer process and a peer thread, with the peer
+// on the same CPU, an SMT sibling and another core, or only where --child
+// says. Placements with no fitting CPU are skipped. Round trips per second
+// come from the mean round trip.
+static void run_pingpong(const struct scenario* s, uint64_t iters) {
+    if (opt.scale != SCALE_NONE) {
+        fprintf(stderr, "note: %s has no scaling mode\n", s->name);
+        return;
+    }
+    struct row {
+        enum pp_kind   kind;
+        bool           threads;
+        enum placement where;
+        struct stats   one_way, round_trip;
+    };
+    struct row rows[PP_KINDS * 2 * 3];
+    int nrows = 0;
+
+    enum placement wheres[] = { PLACE_SAME, PLACE_SIBLING, PLACE_OTHER };
+    int nwheres = 3;
+    if (place.child != PLACE_UNPINNED) { wheres[0] = place.child; nwheres = 1; }
+
+    // the peer placement is relative to the measuring thread, so pin it
+    struct placement_state saved = place;
+    if (place.parent_cpu < 0) {
+        place.parent_cpu = sched_getcpu();
+        pin_self(place.parent_cpu);
+    }
+    for (int w = 0; w < nwheres; ++w) {
+        place.child = wheres[w];
+        place.child_cpu = wheres[w] == PLACE_SAME ? place.parent_cpu : resolve_child_cpu();
+        if (place.child_cpu < 0) {
+            fprintf(stderr, "note: no %s CPU for cpu %d, skipping\n",
+                    placement_names[wheres[w]], place.parent_cpu);
+            continue;
+        }
+        for (int k = 0; k < PP_KINDS; ++k) {
+            for (int t = 0; t < 2; ++t) {
+                struct row* r = &rows[nrows++];
+                *r = (struct row){ (enum pp_kind)k, t == 1, wheres[w], { 0 }, { 0 } };
+                const char* peer = r->threads ? "thread" : "process";
+                sigset_t mask;
+                pp_start(r->kind, r->threads, &mask);
+                char label[160];
+                snprintf(label, sizeof label, "%s_%s_%s_%s_one_way", s->name,
+                         pp_kind_names[k], peer, placement_names[wheres[w]]);
+                r->one_way = measure(label, NULL, act_pingpong_one_way, NULL,
+                                     iters ? iters : s->iters, false);
+                snprintf(label, sizeof label, "%s_%s_%s_%s_round_trip", s->name,
+                         pp_kind_names[k], peer, placement_names[wheres[w]]);
+                r->round_trip = measure(label, NULL, act_pingpong_round_trip, NULL,
+                                        iters ? iters : s->iters, false);
+                pp_stop(&mask);
+            }
+        }
+    }
+    if (saved.parent_cpu < 0) sched_setaffinity(0, sizeof place.orig_mask, &place.orig_mask);
+    place = saved;
+
+    char name[300];
+    snprintf(name, sizeof name, "%s_summary", s->name);
+    out_begin(name);
+    if (out.fmt == FORMAT_TEXT)
+        printf("primitive,peer,placement,one_way_p50_%s,one_way_p99_%s,round_trip_p50_%s,"
+               "round_trips_per_s\n", report.unit, report.unit, report.unit);
+    for (int i = 0; i < nrows; ++i) {
+        const struct row* r = &rows[i];
+        const char* peer = r->threads ? "thread" : "process";
+        double per_s = r->round_trip.mean > 0 ? 1e9 / (r->round_trip.mean * clk.ns_per_tick) : 0.0;
+        if (out.fmt == FORMAT_TEXT) {
+            printf("%s,%s,%s,%.3f,%.3f,%.3f,%.1f\n", pp_kind_names[r->kind], peer,
+                   placement_names[r->where], r->one_way.p50 * report.per_tick,
+                   r->one_way.p99 * report.per_tick, r->round_trip.p50 * report.per_tick, per_s);
+            continue;
+        }
+        char key[96];
+        snprintf(key, sizeof key, "%s_%s_%s_one_way_p50", pp_kind_names[r->kind], peer,
+                 placement_names[r->where]);
+        out_stat(key, "total", r->one_way.p50);
+        snprintf(key, sizeof key, "%s_%s_%s_one_way_p99", pp_kind_names[r->kind], peer,
+                 placement_names[r->where]);
+        out_stat(key, "total", r->one_way.p99);
+        snprintf(key, sizeof key, "%s_%s_%s_round_trip_p50", pp_kind_names[r->kind], peer,
+                 placement_names[r->where]);
+        out_stat(key, "total", r->round_trip.p50);
+        snprintf(key, sizeof key, "%s_%s_%s_round_trips_per_s", pp_kind_names[r->kind], peer,
+                 placement_names[r->where]);
+        out_num(key, "%.1f", per_s);
+    }
+    out_end();
+}
+
+static void list_scenarios(void) {
+    printf("id,name,iters,subtract_overhead,tags\n");
+    for (size_t i = 0; i < NSCENARIOS; ++i) {
+        const struct scenario* s = &scenarios[i];
+        printf("%d,%s,%" PRIu64 ",%d,\"%s\"\n", s->id, s->name, s->iters,
+               s->subtract_overhead, s->tags);
+    }
+}
+
+// Each scenario runs in a fresh child so one cannot leave children,
+// caches or allocator state behind for the next.
+static bool run_isolated(const struct scenario* s, uint64_t iters) {
+    fflush(stdout);
+    pid_t p = fork();
+    if (p < 0) { perror("fork"); exit(1); }
+    if (p == 0) {
+        env_lock_self();
+        if (s->run) s->run(s, iters);
+        else measure(s->name, s->setup_each, s->action, s->teardown_each,
+                     iters ? iters : s->iters, s->subtract_overhead);
+        fflush(stdout);
+        _exit(0);
+    }
+    int st;
+    if (waitpid(p, &st, 0) < 0) { perror("waitpid"); exit(1); }
+    if (WIFEXITED(st) && WEXITSTATUS(st) == 0) return true;
+    fprintf(stderr, "%s failed (%s %d)\n", s->name,
+            WIFEXITED(st) ? "exit" : "signal", WIFEXITED(st) ? WEXITSTATUS(st) : WTERMSIG(st));
+    return false;
+}
+
+// ========== driver ==========
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [options] <scenario>...\n"
+        "       %s [options] --all | --tag=TAG...\n"
+        "       %s --list\n"
+        "       %s [--save-hist=DIR] --merge FILE.hist...\n"
+        "       %s [--threshold=F] [--alpha=P] --compare DIR_A DIR_B\n"
+        "  scenarios are numbers, names or globs over names (\"*fork*\");\n"
+        "  each runs in a fresh child process\n"
+        "  --all             run every scenario\n"
+        "  --tag=TAG         run scenarios tagged TAG (repeatable)\n"
+        "  --list            list scenarios with defaults and tags\n"
+        "  --iters=N         override the default sample count\n"
+        "  --hist            record into a fixed-size log-linear histogram\n"
+        "                    (3 significant digits) instead of raw samples\n"
+        "  --save-hist=DIR   write histograms to DIR/<label>_<series>.hist\n"
+        "  --save-samples=DIR  write raw samples to DIR/<label>_<series>.samples\n"
+        "  --merge           merge saved histograms and report the result\n"
+        "  --compare         compare the saved series of two directories with a\n"
+        "                    Mann-Whitney U test and Cliff's delta; exit 1 when\n"
+        "                    one is significantly slower by more than the threshold\n"
+        "  --threshold=F     relative median change counted as a regression (0.05)\n"
+        "  --alpha=P         significance level for --compare (0.01)\n"
+        "  --clock=KIND      monotonic (default), tsc, or auto; tsc fails and auto\n"
+        "                    falls back to monotonic without an invariant TSC\n"
+        "  --units=UNIT      ns (default) or cycles (TSC clock only)\n"
+        "  --batch[=K]       time K back-to-back actions per sample against an\n"
+        "                    empty loop of K; K defaults to the smallest power\n"
+        "                    of two giving samples of at least 1 us\n"
+        "  --rel-err=R       run until the 95%% CI of the median is within +-R\n"
+        "                    of it (e.g. 0.01), instead of a fixed count\n"
+        "  --time-budget=S   stop adaptive sampling after S seconds (default 30)\n"
+        "  --max-iters=N     stop adaptive sampling after N samples\n"
+        "  --warmup=N        run exactly N warm-up iterations; by default warm-up\n"
+        "                    runs until the median of 16-sample windows is stable\n"
+        "  --warmup-tol=F    relative median change counted as stable (0.05)\n"
+        "  --warmup-min=N    least warm-up iterations before stopping (48)\n"
+        "  --warmup-max=N    most warm-up iterations (default iters/10 + 1)\n"
+        "  --overhead-order=O  when the empty region is timed: alternate (default)\n"
+        "                    or random pairs with the action, or trailing after\n"
+        "                    all samples; pairs add a per-pair difference series\n"
+        "  --perf            report perf_event counters per operation; falls\n"
+        "                    back to software events without PMU access\n"
+        "  --pin=CPU         pin the measuring process to CPU\n"
+        "  --child=WHERE     where forked children run: unpinned (default),\n"
+        "                    same, sibling (SMT) or other (another core);\n"
+        "                    pins the parent to its current CPU if no --pin\n"
+        "  --scale=KIND      run the scenario in N concurrent threads or procs\n"
+        "                    with a common start, N = 1, 2, 4, ... ncpu\n"
+        "  --workers=N       scaling: run only N workers\n"
+        "  --footprint=LIST  footprint sweep: parent sizes (1M,16M,256M,1G)\n"
+        "  --footprint-pages=LIST   4k and/or thp (default 4k,thp)\n"
+        "  --footprint-advice=LIST  none, dontfork and/or wipeonfork on the\n"
+        "                    parent's memory (default all three)\n"
+        "  --cow-size=SIZE   CoW faults: working set shared with the child (64M)\n"
+        "  --cow-pages=K     CoW faults: pages of the backing size written (32)\n"
+        "  --snapshot-size=SIZE  snapshot: heap forked and serialized (256M)\n"
+        "  --thread-stacks=LIST  thread stack sweep: sizes (16K,64K,256K,1M,8M)\n"
+        "  --thread-guards=LIST  thread stack sweep: guard sizes (0,4K,64K)\n"
+        "  --helpers=DIR     exec matrix: helper executables (default helpers/bin\n"
+        "                    next to this binary; build with \"make helpers\")\n"
+        "  --bootstrap=B     bootstrap resamples for the median and mean CIs\n"
+        "                    (default 1000, 0 = off; histograms use order\n"
+        "                    statistics and the normal approximation)\n"
+        "  --format=FMT      text (default), json (one object per line) or\n"
+        "                    csv (scenario,key,value); json and csv include\n"
+        "                    host metadata with every result\n"
+        "  --preflight       report the environment checks and exit, 1 if noisy\n"
+        "  --strict[=MODE]   on a noisy host (governor not performance, turbo or\n"
+        "                    SMT on, load, cgroup CPU quota): refuse (default)\n"
+        "                    to run, or mark results reliable=0\n"
+        "  --mlock           lock memory and pre-fault stack and sample buffers\n",
+        prog, prog, prog, prog, prog);
+}
+
+int main(int argc, char** argv) {
+    enum { OPT_HIST = 256, OPT_SAVE_HIST, OPT_MERGE, OPT_CLOCK, OPT_UNITS, OPT_BATCH,
+           OPT_REL_ERR, OPT_TIME_BUDGET, OPT_MAX_ITERS, OPT_PERF,
+           OPT_PIN, OPT_CHILD, OPT_SCALE, OPT_WORKERS, OPT_FORMAT,
+           OPT_ALL, OPT_TAG, OPT_LIST, OPT_ITERS, OPT_BOOTSTRAP,
+           OPT_OVERHEAD_ORDER, OPT_WARMUP, OPT_WARMUP_TOL, OPT_WARMUP_MIN,
+           OPT_WARMUP_MAX, OPT_SAVE_SAMPLES, OPT_COMPARE, OPT_THRESHOLD, OPT_ALPHA,
+           OPT_PREFLIGHT, OPT_STRICT, OPT_MLOCK, OPT_FOOTPRINT, OPT_FP_PAGES, OPT_FP_ADVICE,
+           OPT_COW_SIZE, OPT_COW_PAGES, OPT_SNAP_SIZE,
+           OPT_HELPERS, OPT_STACKS, OPT_GUARDS };
+    static const struct option longopts[] = {
+        { "hist",      no_argument,       NULL, OPT_HIST },
+        { "save-hist", required_argument, NULL, OPT_SAVE_HIST },
+        { "merge",     no_argument,       NULL, OPT_MERGE },
+        { "save-samples", required_argument, NULL, OPT_SAVE_SAMPLES },
+        { "compare",   no_argument,       NULL, OPT_COMPARE },
+        { "threshold", required_argument, NULL, OPT_THRESHOLD },
+        { "alpha",     required_argument, NULL, OPT_ALPHA },
+        { "clock",     required_argument, NULL, OPT_CLOCK },
+        { "units",     required_argument, NULL, OPT_UNITS },
+        { "batch",     optional_argument, NULL, OPT_BATCH },
+        { "rel-err",     required_argument, NULL, OPT_REL_ERR },
+        { "time-budget", required_argument, NULL, OPT_TIME_BUDGET },
+        { "max-iters",   required_argument, NULL, OPT_MAX_ITERS },
+        { "warmup",      required_argument, NULL, OPT_WARMUP },
+        { "warmup-tol",  required_argument, NULL, OPT_WARMUP_TOL },
+        { "warmup-min",  required_argument, NULL, OPT_WARMUP_MIN },
+        { "warmup-max",  required_argument, NULL, OPT_WARMUP_MAX },
+        { "perf",        no_argument,       NULL, OPT_PERF },
+        { "pin",         required_argument, NULL, OPT_PIN },
+        { "child",       required_argument, NULL, OPT_CHILD },
+        { "scale",       required_argument, NULL, OPT_SCALE },
+        { "workers",     required_argument, NULL, OPT_WORKERS },
+        { "format",      required_argument, NULL, OPT_FORMAT },
+        { "all",         no_argument,       NULL, OPT_ALL },
+        { "tag",         required_argument, NULL, OPT_TAG },
+        { "list",        no_argument,       NULL, OPT_LIST },
+        { "iters",       required_argument, NULL, OPT_ITERS },
+        { "bootstrap",   required_argument, NULL, OPT_BOOTSTRAP },
+        { "overhead-order", required_argument, NULL, OPT_OVERHEAD_ORDER },
+        { "preflight",   no_argument,       NULL, OPT_PREFLIGHT },
+        { "strict",      optional_argument, NULL, OPT_STRICT },
+        { "mlock",       no_argument,       NULL, OPT_MLOCK },
+        { "footprint",   required_argument, NULL, OPT_FOOTPRINT },
+        { "footprint-pages",  required_argument, NULL, OPT_FP_PAGES },
+        { "footprint-advice", required_argument, NULL, OPT_FP_ADVICE },
+        { "cow-size",    required_argument, NULL, OPT_COW_SIZE },
+        { "cow-pages",   required_argument, NULL, OPT_COW_PAGES },
+        { "snapshot-size", required_argument, NULL, OPT_SNAP_SIZE },
+        { "helpers",     required_argument, NULL, OPT_HELPERS },
+        { "thread-stacks", required_argument, NULL, OPT_STACKS },
+        { "thread-guards", required_argument, NULL, OPT_GUARDS },
+        { NULL, 0, NULL, 0 }
+    };
+    bool merge = false, compare = false, preflight = false, cycles = false;
+    enum clock_request want_clock = CLOCK_WANT_MONOTONIC;
+    double threshold = 0.05, alpha = 0.01;
+    int pin_cpu = -1;
+    enum placement child = PLACE_UNPINNED;
+    bool selected[NSCENARIOS] = { false }, any = false;
+    uint64_t iters = 0;
+    int c;
+    while ((c = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
+        switch (c) {
+            case OPT_HIST:      opt.hist = true; break;
+            case OPT_SAVE_HIST: opt.save_dir = optarg; opt.hist = true; break;
+            case OPT_MERGE:     merge = true; break;
+            case OPT_SAVE_SAMPLES: opt.samples_dir = optarg; break;
+            case OPT_COMPARE:   compare = true; break;
+            case OPT_PREFLIGHT: preflight = true; break;
+            case OPT_MLOCK:     env.lock = true; break;
+            case OPT_FOOTPRINT: opt.footprints = optarg; break;
+            case OPT_FP_PAGES:  opt.fp_pages = optarg; break;
+            case OPT_FP_ADVICE: opt.fp_advice = optarg; break;
+            case OPT_COW_SIZE:  opt.cow_size = parse_size(optarg); break;
+            case OPT_COW_PAGES: opt.cow_pages = strtoull(optarg, NULL, 10); break;
+            case OPT_SNAP_SIZE: opt.snap_size = parse_size(optarg); break;
+            case OPT_HELPERS:   opt.helper_dir = optarg; break;
+            case OPT_STACKS:    opt.stacks = optarg; break;
+            case OPT_GUARDS:    opt.guards = optarg; break;
+            case OPT_STRICT: {
+                int k = STRICT_REFUSE;
+                if (optarg) {
+                    k = 1;
+                    while (k < 3 && strcmp(optarg, strict_names[k]) != 0) ++k;
+                    if (k == 3) { usage(argv[0]); return 2; }
+                }
+                env.strict = k;
+                break;
+            }
+            case OPT_THRESHOLD: threshold = strtod(optarg, NULL); break;
+            case OPT_ALPHA:     alpha = strtod(optarg, NULL); break;
+            case OPT_CLOCK:
+                if (strcmp(optarg, "tsc") == 0) want_clock = CLOCK_WANT_TSC;
+                else if (strcmp(optarg, "auto") == 0) want_clock = CLOCK_WANT_AUTO;
+                else if (strcmp(optarg, "monotonic") == 0) want_clock = CLOCK_WANT_MONOTONIC;
+                else { usage(argv[0]); return 2; }
+                break;
+            case OPT_UNITS:
+                if (strcmp(optarg, "cycles") == 0) cycles = true;
+                else if (strcmp(optarg, "ns") == 0) cycles = false;
+                else { usage(argv[0]); return 2; }
+                break;
+            case OPT_BATCH:
+                opt.batch = true;
+                opt.batch_k = optarg ? strtoull(optarg, NULL, 10) : 0;
+                break;
+            case OPT_REL_ERR:     opt.rel_err = strtod(optarg, NULL); break;
+            case OPT_TIME_BUDGET: opt.budget_s = strtod(optarg, NULL); break;
+            case OPT_MAX_ITERS:   opt.max_iters = strtoull(optarg, NULL, 10); break;
+            case OPT_WARMUP:      opt.warmup = (int64_t)strtoull(optarg, NULL, 10); break;
+            case OPT_WARMUP_TOL:  opt.warmup_tol = strtod(optarg, NULL); break;
+            case OPT_WARMUP_MIN:  opt.warmup_min = strtoull(optarg, NULL, 10); break;
+            case OPT_WARMUP_MAX:  opt.warmup_max = strtoull(optarg, NULL, 10); break;
+            case OPT_PERF:        opt.perf = true; break;
+            case OPT_PIN:         pin_cpu = atoi(optarg); break;
+            case OPT_SCALE:
+                if (strcmp(optarg, "threads") == 0) opt.scale = SCALE_THREADS;
+                else if (strcmp(optarg, "procs") == 0) opt.scale = SCALE_PROCS;
+                else { usage(argv[0]); return 2; }
+                break;
+            case OPT_WORKERS:
+                opt.workers = atoi(optarg);
+                if (opt.workers < 1) { usage(argv[0]); return 2; }
+                break;
+            case OPT_FORMAT:
+                if (strcmp(optarg, "text") == 0) out.fmt = FORMAT_TEXT;
+                else if (strcmp(optarg, "json") == 0) out.fmt = FORMAT_JSON;
+                else if (strcmp(optarg, "csv") == 0) out.fmt = FORMAT_CSV;
+                else { usage(argv[0]); return 2; }
+                break;
+            case OPT_ALL:
+                for (size_t i = 0; i < NSCENARIOS; ++i) selected[i] = any = true;
+                break;
+            case OPT_TAG:
+                for (size_t i = 0; i < NSCENARIOS; ++i)
+                    if (has_tag(scenarios[i].tags, optarg)) selected[i] = any = true;
+                break;
+            case OPT_LIST:  list_scenarios(); return 0;
+            case OPT_BOOTSTRAP: opt.bootstrap = (unsigned)strtoul(optarg, NULL, 10); break;
+            case OPT_OVERHEAD_ORDER: {
+                int k = 0;
+                while (k < 3 && strcmp(optarg, order_names[k]) != 0) ++k;
+                if (k == 3) { usage(argv[0]); return 2; }
+                opt.order = k;
+                break;
+            }
+            case OPT_ITERS:
+                iters = strtoull(optarg, NULL, 10);
+                if (iters == 0) { usage(argv[0]); return 2; }
+                break;
+            case OPT_CHILD: {
+                int k = 0;
+                while (k < 4 && strcmp(optarg, placement_names[k]) != 0) ++k;
+                if (k == 4) { usage(argv[0]); return 2; }
+                child = (enum placement)k;
+                break;
+            }
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (merge) {
+        if (optind >= argc) { usage(argv[0]); return 2; }
+        return merge_main(argc - optind, argv + optind, cycles);
+    }
+    if (compare) {
+        if (argc - optind != 2) { usage(argv[0]); return 2; }
+        return compare_main(argv[optind], argv[optind + 1], threshold, alpha);
+    }
+    env_check();
+    if (preflight) {
+        out_header();
+        out_begin("preflight");
+        print_env();
+        out_end();
+        return env.issues ? 1 : 0;
+    }
+    if (env.strict == STRICT_REFUSE && env.issues) {
+        fprintf(stderr, "refusing to run on a noisy host (--strict=mark to run anyway)\n");
+        return 2;
+    }
+    for (int a = optind; a < argc; ++a) {
+        bool hit = false;
+        for (size_t i = 0; i < NSCENARIOS; ++i)
+            if (scenario_matches(&scenarios[i], argv[a])) selected[i] = hit = any = true;
+        if (!hit) { fprintf(stderr, "no scenario matches %s\n", argv[a]); return 2; }
+    }
+    if (!any) { usage(argv[0]); return 2; }
+
+    placement_init(pin_cpu, child);
+    clock_init(want_clock);
+    report_init(cycles, clk.ns_per_tick, clk.kind == CLOCK_KIND_TSC);
+
+    if (access(TRUE_PATH, X_OK) != 0 && access("/usr/bin/true", X_OK) == 0) {
+        TRUE_PATH = "/usr/bin/true";
+    }
+
+    srand48(0xC0FFEE);
+
+    out_header();
+    bool ok = true;
+    for (size_t i = 0; i < NSCENARIOS; ++i)
+        if (selected[i]) ok &= run_isolated(&scenarios[i], iters);
+    return ok ? 0 : 1;
 }
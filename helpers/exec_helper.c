@@ -0,0 +1,31 @@
+// Exec target for the exec cost scenarios of gettimings. When GT_STAMP_FD
+// names an inherited shared memory fd, main() first stores CLOCK_MONOTONIC
+// there so the parent can tell time to main from time to exit.
+// The Makefile builds it static, dynamic with 0/10/50 libraries, and with
+// BIG_TEXT_MB of never-run code.
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#ifdef BIG_TEXT_MB
+  #define STR_(x) #x
+  #define STR(x) STR_(x)
+__asm__(".pushsection .text.gt_bulk,\"ax\",@progbits\n\t"
+        ".fill " STR(BIG_TEXT_MB) " * 1048576, 1, 0xcc\n\t"
+        ".popsection");
+#endif
+
+int main(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    const char* fd = getenv("GT_STAMP_FD");
+    if (fd) {
+        uint64_t* stamp = mmap(NULL, sizeof *stamp, PROT_READ | PROT_WRITE, MAP_SHARED, atoi(fd), 0);
+        if (stamp == MAP_FAILED) return 1;
+        *stamp = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+// One of the shared libraries the exec_dyn helpers are linked against.
+// LIBNO makes each distinct; the pointer table gives the loader some
+// relocations to process, like a real library would.
+#define CAT_(a, b) a##b
+#define CAT(a, b) CAT_(a, b)
+
+int CAT(gtlib_value_, LIBNO) = LIBNO;
+
+int CAT(gtlib_fn_, LIBNO)(void) { return CAT(gtlib_value_, LIBNO); }
+
+int (*const CAT(gtlib_table_, LIBNO)[])(void) = {
+    CAT(gtlib_fn_, LIBNO), CAT(gtlib_fn_, LIBNO), CAT(gtlib_fn_, LIBNO), CAT(gtlib_fn_, LIBNO),
+};